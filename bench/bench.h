@@ -0,0 +1,29 @@
+#ifndef bench_h__
+#define bench_h__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// Every case runs this many times and reports its fastest run.
+const int BENCH_REPEATS = 5;
+
+template <typename F> double bestOf(F &&fn)
+{
+    double best = 1e30;
+    for (int i = 0; i < BENCH_REPEATS; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, elapsed);
+    }
+    return best;
+}
+
+inline void report(const char *name, size_t count, double seconds)
+{
+    printf("%-48s %14.0f entities/s\n", name, count / seconds);
+}
+
+#endif // bench_h__
@@ -0,0 +1,79 @@
+// Sparse set storages against the archetype backend on the same scenes: entity creation, single and multi
+// component iteration, and adding and removing a component on every entity.
+
+#include "bench.h"
+#include "registry.h"
+#include "components/core.h"
+#include "components/transform.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+// Every entity has a Transform, a BBox and an Info, every other one a Relation too, so both backends see two
+// signatures.
+void populate(Registry &r, size_t count, std::vector<Handle> &entities)
+{
+    entities.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        auto entity = r.createEntity(Transform(vec3(float(i), 0, 0), glm::identity<quat>(), vec3(1.0f)),
+                                     BBox(vec3(-1.0f), vec3(1.0f)), Info{"entity"});
+        if (i % 2)
+            r.addComponent(entity, Relation());
+        entities.push_back(entity);
+    }
+}
+
+void run(Registry::Backend backend, const char *backendName, size_t count)
+{
+    char name[64];
+    auto label = [&](const char *what) {
+        snprintf(name, sizeof(name), "%s %zu %s", backendName, count, what);
+        return name;
+    };
+    std::vector<Handle> entities;
+
+    std::deque<Registry> scratch;
+    report(label("create"), count, bestOf([&]() { populate(scratch.emplace_back(backend), count, entities); }));
+    scratch.clear();
+
+    Registry r(backend);
+    populate(r, count, entities);
+    float sum = 0;
+    report(label("each<Transform>"), count, bestOf([&]() {
+               r.each<Transform>([&](Handle, Transform &transform) { sum += transform.position.x; });
+           }));
+    report(label("each<Transform, BBox>"), count, bestOf([&]() {
+               r.each<Transform, BBox>([&](Handle, Transform &transform, BBox &box) {
+                   sum += transform.position.x + box.max.x;
+               });
+           }));
+    report(label("each<Transform, BBox, Relation>"), count / 2, bestOf([&]() {
+               r.each<Transform, BBox, Relation>([&](Handle, Transform &transform, BBox &, Relation &) {
+                   sum += transform.position.y;
+               });
+           }));
+    report(label("add and remove Relation"), count, bestOf([&]() {
+               for (auto entity : entities)
+               {
+                   if (r.has<Relation>(entity))
+                       r.removeComponent<Relation>(entity);
+                   else
+                       r.addComponent(entity, Relation());
+               }
+           }));
+    // Keeps the loops from being optimized away.
+    if (sum == -1.0f)
+        printf("\n");
+}
+
+int main()
+{
+    for (size_t count : {10000, 100000})
+    {
+        run(Registry::Backend::Sparse, "sparse", count);
+        run(Registry::Backend::Archetype, "archetype", count);
+    }
+    return 0;
+}
@@ -0,0 +1,186 @@
+// Scene save and load throughput on 100k entities with an Info, a Transform and a Relation: json through the Encoder
+// that serializer() used to return, json through the field tuples that replaced it, and the binary format.
+
+#include "bench.h"
+#include "registry.h"
+#include "components/core.h"
+#include "components/transform.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The serializer() of before the field tuples: one heap allocated Serializer per field, built on every call and
+// walked through virtual calls. The original leaked them, this copy frees them.
+namespace baseline
+{
+struct SerializerBase
+{
+    std::string name;
+
+    SerializerBase(std::string name) : name(name)
+    {
+    }
+    virtual ~SerializerBase()
+    {
+    }
+
+    virtual void serialize(void *obj, json &j) = 0;
+    virtual void unserialize(void *obj, const json &j) = 0;
+};
+
+struct Encoder
+{
+    std::vector<std::unique_ptr<SerializerBase>> serializers;
+
+    void serialize(void *obj, json &j)
+    {
+        for (auto &s : serializers)
+            s->serialize(obj, j[s->name]);
+    }
+
+    void unserialize(void *obj, const json &j)
+    {
+        for (auto &s : serializers)
+            s->unserialize(obj, j[s->name]);
+    }
+};
+
+template <typename C, typename T> struct Serializer : SerializerBase
+{
+    T C::*member;
+
+    Serializer(const char *name, T C::*member) : SerializerBase(name), member(member)
+    {
+    }
+
+    void serialize(void *obj, json &j) override
+    {
+        j = json(((C *)obj)->*member);
+    }
+
+    void unserialize(void *obj, const json &j) override
+    {
+        ((C *)obj)->*member = j.get<T>();
+    }
+};
+
+inline void add(Encoder &)
+{
+}
+
+template <typename C, typename T, typename... Args>
+void add(Encoder &encoder, const char *name, T C::*field, Args... args)
+{
+    encoder.serializers.emplace_back(new Serializer<C, T>(name, field));
+    add(encoder, args...);
+}
+
+template <typename... Args> Encoder encoder(Args... args)
+{
+    Encoder encoder;
+    add(encoder, args...);
+    return encoder;
+}
+
+template <class C> Encoder serializer();
+
+template <> Encoder serializer<Info>()
+{
+    return encoder("name", &Info::name, "scope", &Info::scope, "active", &Info::active);
+}
+
+template <> Encoder serializer<Transform>()
+{
+    return encoder("position", &Transform::position, "rotation", &Transform::rotation, "scaling",
+                   &Transform::scaling);
+}
+
+template <> Encoder serializer<Relation>()
+{
+    return encoder("parent", &Relation::parent, "children", &Relation::children);
+}
+
+// Like Storage::serialize did, the encoder is built once per entity and component.
+template <class C> void save(Registry &r, Handle entity, json &j)
+{
+    if (auto component = r.read<C>(entity))
+    {
+        auto &jc = j[typeid(C).name()];
+        jc = json::object();
+        serializer<C>().serialize((void *)component, jc);
+    }
+}
+
+template <class C> void load(Registry &r, Handle entity, const json &j)
+{
+    auto it = j.find(typeid(C).name());
+    if (it != j.end())
+        serializer<C>().unserialize(&r.get<C>(entity), *it);
+}
+
+void toJson(Registry &r, std::vector<Handle> &entities, json &out)
+{
+    out = json::object();
+    for (auto entity : entities)
+    {
+        auto j = json::object();
+        save<Info>(r, entity, j);
+        save<Transform>(r, entity, j);
+        save<Relation>(r, entity, j);
+        out[std::to_string(entity)] = j;
+    }
+}
+
+void fromJson(Registry &r, const json &in)
+{
+    for (auto &el : in.items())
+    {
+        Handle entity = std::stoull(el.key());
+        r.claim(entity);
+        load<Info>(r, entity, el.value());
+        load<Transform>(r, entity, el.value());
+        load<Relation>(r, entity, el.value());
+    }
+}
+} // namespace baseline
+
+int main()
+{
+    const size_t count = 100000;
+    Registry r;
+    std::vector<Handle> entities;
+    for (size_t i = 0; i < count; i++)
+    {
+        auto entity = r.createEntity(Info{"entity" + std::to_string(i), 0, true},
+                                     Transform(vec3(float(i), 2, 3), glm::identity<quat>(), vec3(1.0f)));
+        Relation relation;
+        relation.parent = entities.empty() ? 0 : entities[0];
+        r.addComponent(entity, relation);
+        entities.push_back(entity);
+    }
+    std::deque<Registry> scratch;
+
+    json before;
+    report("json save, Encoder", count, bestOf([&]() { baseline::toJson(r, entities, before); }));
+    report("json load, Encoder", count, bestOf([&]() { baseline::fromJson(scratch.emplace_back(), before); }));
+    scratch.clear();
+
+    json j;
+    report("json save", count, bestOf([&]() {
+               j = json();
+               r.toJson(entities, j);
+           }));
+    report("json load", count, bestOf([&]() { scratch.emplace_back().fromJson(j); }));
+    scratch.clear();
+
+    std::vector<uint8_t> binary;
+    report("binary save", count, bestOf([&]() {
+               binary.clear();
+               r.toBinary(entities, binary);
+           }));
+    report("binary load", count, bestOf([&]() { scratch.emplace_back().fromBinary(binary.data(), binary.size()); }));
+    scratch.clear();
+    return 0;
+}
@@ -0,0 +1,49 @@
+// TransformBatch::compose against Transform::matrix() one entity at a time, at 10k, 100k and 1M entities.
+
+#include "bench.h"
+#include "transformbatch.h"
+#include "components/transform.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+int main()
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for (size_t count : {10000, 100000, 1000000})
+    {
+        std::vector<Transform> transforms(count);
+        TransformBatch batch;
+        for (auto &transform : transforms)
+        {
+            transform.position = vec3(unit(random), unit(random), unit(random)) * 100.0f;
+            transform.rotation = glm::normalize(quat(unit(random), unit(random), unit(random), unit(random)));
+            transform.scaling = vec3(unit(random), unit(random), unit(random)) + vec3(2.0f);
+            batch.push(transform.position, transform.rotation, transform.scaling);
+        }
+
+        std::vector<mat4> scalar(count), batched(count);
+        char name[64];
+        snprintf(name, sizeof(name), "Transform::matrix %zu", count);
+        report(name, count, bestOf([&]() {
+                   for (size_t i = 0; i < count; i++)
+                       scalar[i] = transforms[i].matrix();
+               }));
+        snprintf(name, sizeof(name), "TransformBatch::compose %zu", count);
+        report(name, count, bestOf([&]() { batch.compose(batched.data()); }));
+
+        float error = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                for (int r = 0; r < 4; r++)
+                    error = std::max(error, std::abs(scalar[i][c][r] - batched[i][c][r]));
+            }
+        }
+        printf("largest difference %g\n", error);
+    }
+    return 0;
+}
@@ -20,6 +20,7 @@
 #endif
 
 #include <chrono>
+#include <filesystem>
 #include <thread>
 #include <fstream>
 
@@ -27,6 +28,12 @@
 
 Editor *Editor::_instance = nullptr;
 
+// Time per frame spent applying a scene that loads across frames.
+const std::chrono::microseconds SCENE_LOAD_BUDGET(4000);
+
+// Appended to the scene path for the journal of changes saved since its last full save.
+const char *JOURNAL_SUFFIX = ".journal";
+
 void Editor::start()
 {
     UISys::start();
@@ -43,6 +50,9 @@ void Editor::start()
 
     createViewport("first");
     createViewport("second");
+
+    history = new Snapshots(r);
+    history->record(false);
 }
 
 void Editor::process()
@@ -54,6 +64,29 @@ void Editor::process()
         canvasGeo.indices.clear();
         canvasGeo.updated = true;
     });
+    if (sceneLoader && sceneLoader->step(SCENE_LOAD_BUDGET))
+    {
+        if (sceneLoader->failed())
+            LOG_F(ERROR, "%s", sceneLoader->errorMessage().c_str());
+        sceneLoader.reset();
+        opened(scenePath);
+    }
+
+    // Only what the editor itself changes becomes undo steps, scenes loading across frames, LoadSys instantiating
+    // protos and the game are left out.
+    history->record(true);
+
+    // The inspector and the gizmos write the selected components in place.
+    for (auto entity : r->get<EditorState>(editor).selection)
+        r->touch(entity);
+
+    // GLFW key codes of letters match their upper case characters.
+    auto &io = ImGui::GetIO();
+    if (io.KeyCtrl && !io.WantTextInput && ImGui::IsKeyPressed('Z'))
+        history->undo();
+    if (io.KeyCtrl && !io.WantTextInput && ImGui::IsKeyPressed('Y'))
+        history->redo();
+
     mainWindow();
     static bool show_demo_window = true;
     ImGui::ShowDemoWindow(&show_demo_window);
@@ -62,12 +95,17 @@ void Editor::process()
     assets->gui();
     registry->gui();
     modifiers->gui();
+    history->record(false);
 
     game.load();
     if (game.updateGame)
     {
         game.updateGame();
     }
+
+    // A drag or an edit in progress becomes one undo step once it ends.
+    if (!ImGui::IsAnyMouseDown() && !ImGui::IsAnyItemActive())
+        history->commit();
 }
 
 void Editor::mainWindow()
@@ -130,6 +168,16 @@ void Editor::mainWindow()
                  ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoResize |
                      ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse);
     ImGui::Text("Fps: %.1f", ImGui::GetIO().Framerate);
+    ImGui::SameLine();
+    ImGui::Text("Destroyed: %d", int(r->destroyedLastFrame()));
+    ImGui::SameLine();
+    auto &stats = RenderSys::instance()->frameStats();
+    ImGui::Text("Draws: %u Binds: %u Uniforms: %u", stats.draws, stats.binds, stats.uniforms);
+    if (sceneLoader)
+    {
+        ImGui::SameLine();
+        ImGui::Text("Loading: %d entities", int(sceneLoader->loaded()));
+    }
     ImGui::End();
     ImGui::PopStyleVar(3);
 }
@@ -155,6 +203,36 @@ bool hasParentComponent(Registry* r, Handle entity, bool includeSelf = false)
     return false;
 }
 
+// Scenes saved with the .scene extension use the binary format, anything else is json.
+static bool isBinaryScene(const std::string &fn)
+{
+    return std::filesystem::path(fn).extension() == ".scene";
+}
+
+// Entities that are saved with the scene, editor entities and the ones instantiated from protos are not.
+static bool isSceneEntity(Registry *r, Handle entity)
+{
+    auto inf = r->getPtr<Info>(entity);
+    if (inf && inf->scope != 0)
+        return false;
+    if (hasParentComponent<Proto>(r, entity, true))
+        return false;
+    return !hasParentComponent<Ref>(r, entity);
+}
+
+void Editor::opened(const std::string &path)
+{
+    try
+    {
+        Snapshots::loadIncremental(r, path + JOURNAL_SUFFIX);
+    }
+    catch (std::exception &e)
+    {
+        LOG_F(ERROR, "%s%s: %s", path.c_str(), JOURNAL_SUFFIX, e.what());
+    }
+    history->clear();
+}
+
 void Editor::menu()
 {
     if (ImGui::BeginMenuBar())
@@ -165,11 +243,30 @@ void Editor::menu()
             {
                 auto fn = EditorUtils::openFileName(".json");
                 if (!fn.empty())
+                    scenePath = fn;
+                if (!fn.empty() && isBinaryScene(fn))
+                {
+                    try
+                    {
+                        if (!r->loadBinary(fn))
+                            LOG_F(ERROR, "could not open %s", fn.c_str());
+                        opened(fn);
+                    }
+                    catch (std::exception &e)
+                    {
+                        LOG_F(ERROR, "%s: %s", fn.c_str(), e.what());
+                    }
+                }
+                else if (!fn.empty() && loadAcrossFrames)
                 {
-                    std::ifstream is(fn);
-                    json j;
-                    is >> j;
-                    r->fromJson(j);                    
+                    sceneLoader = std::make_unique<SceneLoader>(r, fn);
+                }
+                else if (!fn.empty())
+                {
+                    SceneLoader loader(r, fn);
+                    if (!loader.load())
+                        LOG_F(ERROR, "%s", loader.errorMessage().c_str());
+                    opened(fn);
                 }
             }
             if (ImGui::MenuItem("Save", ""))
@@ -178,29 +275,51 @@ void Editor::menu()
                 if (!fn.empty())
                 {                    
                     json j;   
-                    std::vector<int> entities;
+                    std::vector<Handle> entities;
                     for (auto kv : r->entities())
                     {
-                        auto inf = r->getPtr<Info>(kv.first);
-                        if (inf && inf->scope != 0)
-                            continue;
-                        if (hasParentComponent<Proto>(r, kv.first, true))
-                            continue;
-                        if (hasParentComponent<Ref>(r, kv.first))
-                            continue;
-                        entities.push_back(kv.first);
+                        if (isSceneEntity(r, kv.first))
+                            entities.push_back(kv.first);
                     }
                     
-                    r->toJson(entities, j);
-                    LOG_F(INFO, "serialized: %s", j.dump(4).c_str());
-                    std::ofstream os(fn);
-                    os << j.dump(4);
+                    if (isBinaryScene(fn))
+                    {
+                        if (!r->saveBinary(entities, fn))
+                            LOG_F(ERROR, "could not save %s", fn.c_str());
+                    }
+                    else
+                    {
+                        r->toJson(entities, j);
+                        LOG_F(INFO, "serialized: %s", j.dump(4).c_str());
+                        std::ofstream os(fn);
+                        os << j.dump(4);
+                    }
+                    scenePath = fn;
+                    std::error_code error;
+                    std::filesystem::remove(fn + JOURNAL_SUFFIX, error);
+                    history->saved();
                 }                
             }
+            // Appends only what changed since the last save to a journal next to the scene.
+            if (ImGui::MenuItem("Save Changes", "", false, !scenePath.empty()))
+            {
+                if (!history->saveIncremental(scenePath + JOURNAL_SUFFIX,
+                                              [&](Handle entity) { return isSceneEntity(r, entity); }))
+                    LOG_F(ERROR, "could not save %s%s", scenePath.c_str(), JOURNAL_SUFFIX);
+            }
             ImGui::MenuItem("Save As", "");
+            ImGui::MenuItem("Load Across Frames", "", &loadAcrossFrames);
             ImGui::Separator();
             ImGui::EndMenu();
         }
+        if (ImGui::BeginMenu("Edit"))
+        {
+            if (ImGui::MenuItem("Undo", "Ctrl+Z", false, history->canUndo()))
+                history->undo();
+            if (ImGui::MenuItem("Redo", "Ctrl+Y", false, history->canRedo()))
+                history->redo();
+            ImGui::EndMenu();
+        }
         ImGui::EndMenuBar();
     }
 }
@@ -263,7 +382,7 @@ void Editor::viewports()
                     if (focused != entity)
                     {
                         focused = entity;
-                        LOG_F(INFO, "Focused %d", entity);
+                        LOG_F(INFO, "Focused %llu", (unsigned long long)entity);
                     }
                     auto mouse = ImGui::GetMousePos();
                     mouse.x -= vMin.x;
@@ -389,7 +508,7 @@ void Editor::createViewport(std::string name)
     Viewport vp;
     vp.name = name;
     r->createEntity(
-        Info{name, 1}, vp, pass, camera, Transform{{0, -.05, 0}, mat4(), vec3(1.0)}, canvasGeo);
+        Info{name, 1}, vp, pass, camera, Transform{{0, 0, 0}, mat4(), vec3(1.0)}, canvasGeo);
 }
 
  Game::Game()
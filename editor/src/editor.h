@@ -5,6 +5,10 @@
 #include "systems/uisys.h"
 #include "imgui.h"
 #include "storage.h"
+#include "sceneloader.h"
+#include "snapshots.h"
+
+#include <memory>
 
 
 struct RegistryView;
@@ -66,10 +70,17 @@ class Editor : public UISys
     ModifiersView *modifiers;
     GameView *gameView;
     Game game;
+    // Json scene being loaded across frames, see loadAcrossFrames.
+    std::unique_ptr<SceneLoader> sceneLoader;
+    bool loadAcrossFrames = false;
+    // Undo history of everything changed after start, and the file it is journaled next to.
+    Snapshots *history = nullptr;
+    std::string scenePath;
 
     static Editor *_instance;
     
     void createViewport(std::string name);
+    void opened(const std::string &path);
   public:
     Handle editor;
 
@@ -20,6 +20,7 @@
 
 #include "editor.h"
 #include "systems/transformsys.h"
+#include "systems/spatialsys.h"
 
 
 typedef void(*InitGameProc)(void);
@@ -35,6 +36,7 @@ int main(int argc, char *argv[])
 
     engine->addSystem(new Editor());
     engine->addSystem(new TransformSys());
+    engine->addSystem(SpatialSys::instance());
     engine->addSystem(new RenderSys());
     engine->addSystem(new ResourceSys());
     engine->addSystem(new LoadSys());
@@ -7,6 +7,9 @@
 #include "components/render.h"
 #include "editor.h"
 #include "components/core.h"
+#include "systems/spatialsys.h"
+#include "systems/transformsys.h"
+#include "debugdraw.h"
 #include "loguru.hpp"
 
 Ray mouseRay;
@@ -20,9 +23,10 @@ bool SelectionModifier::process(Handle viewport)
 
     for (auto selected : edState.selection)
     {
-        auto &[transform, box] = Engine::instance()->registry.getEntity<Transform, BBox>(selected);
-        if (&box)
-            geo.addBBox(box, transform.matrix());
+        auto &registry = Engine::instance()->registry;
+        // The gizmos may have moved the selection this frame.
+        if (auto box = registry.read<BBox>(selected))
+            DebugDraw::of(&registry)->box(geo.layer, *box, TransformSys::currentWorld(&registry, selected));
     }
 
     if (!(edState.mouse.x < 1 && edState.mouse.x > 0 && edState.mouse.y < 1 && edState.mouse.y > 0))
@@ -35,18 +39,9 @@ bool SelectionModifier::process(Handle viewport)
         LOG_F(INFO, "mouse: %s", glm::to_string(edState.mouse).c_str());
 
         edState.selection.clear();
-        Handle clicked = 0;
-        float hitDistance = NO_INTERSECT;
-        Engine::instance()->registry.each<Transform, BBox>([&](Handle entity, Transform &t, BBox &box) {
+        Handle clicked = SpatialSys::instance()->raycast(edState.mouseRay, nullptr, [](Handle entity) {
             auto inf = Engine::instance()->registry.getPtr<Info>(entity);
-            if (inf && !inf->active)
-                return;
-            auto hit = (t.matrix() * box).intersect(edState.mouseRay);
-            if (hit < hitDistance)
-            {
-                clicked = entity;
-                hitDistance = hit;
-            }
+            return !inf || inf->active;
         });
         if (clicked)
         {
@@ -68,10 +63,10 @@ bool SelectionModifier::process(Handle viewport)
         }
         if (boxStarted)
         {
-            //geo.addBBox(box, transform.matrix());
+            //DebugDraw::of(&Engine::instance()->registry)->box(geo.layer, box, transform.matrix());
         }
     }
-    //geo.addLineSegment(mouseRay.p, mouseRay.p + mouseRay.n * 100.0f);
+    //DebugDraw::of(&Engine::instance()->registry)->line(geo.layer, mouseRay.p, mouseRay.p + mouseRay.n * 100.0f);
     return false;
 }
 
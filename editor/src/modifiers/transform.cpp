@@ -4,6 +4,7 @@
 #include "types.h"
 #include "editor.h"
 #include "components/render.h"
+#include "debugdraw.h"
 #include "loguru.hpp"
 
 enum class GizmoTipType
@@ -37,7 +38,7 @@ bool drawGizmo(mat4 transform, Ray &movementPlane, vec3 &axis, bool readOnly, Gi
         auto t = edState.mouseRay.rayClosestPointToLineSegment(a, b, 0.125);
         auto high = t > 0;
         auto col = (high || highlighed[indicator]) ? Color::yellow : ax.second;
-        geo.addLineSegment(a, b, col, 0.05f);
+        DebugDraw::of(&Engine::instance()->registry)->line(geo.layer, a, b, col, 0.05f);
         highlighed[indicator++] |= high;
 
         mat3 rot;
@@ -193,7 +194,8 @@ bool drawRotationGizmo(mat4 space, quat &rotation, Ray &movementPlane, mat3 &axi
                 active = true;
             }
         }
-        geo.addCircle(center, 1, w, ax.transform * scale, high ? Color::yellow : ax.color);
+        auto debugDraw = DebugDraw::of(&Engine::instance()->registry);
+        debugDraw->circle(geo.layer, center, 1, ax.transform * scale, high ? Color::yellow : ax.color, w);
     }
     return active;
 }
@@ -234,8 +236,10 @@ bool rotateGizmo(mat4 space, quat &rotation, Handle viewport)
         rotation = glm::rotate(glm::identity<quat>(), newAngle - oldAngle, movementPlane.n) * rotation;
         angleDelta += newAngle - oldAngle;
         oldPos = pos;
-        geo.addCircle(center, 0.99, 0.025f, axisTransform, Color::yellow * 0.75f, true, startAngle,
-                      startAngle + angleDelta);
+        geo.addFilledArc(center, 0.99f, axisTransform, Color::yellow * 0.75f, startAngle, startAngle + angleDelta);
+        DebugDraw::of(&Engine::instance()->registry)
+            ->circle(geo.layer, center, 0.99f, axisTransform, Color::yellow * 0.75f, 0.025f, startAngle,
+                     startAngle + angleDelta);
     }
 
     return started;
@@ -19,7 +19,7 @@ std::string EditorUtils::openFileName(std::string ext)
 	ofn.lpstrFile = szFile;
 	ofn.lpstrFile[0] = '\0';
 	ofn.nMaxFile = sizeof(szFile);
-	ofn.lpstrFilter = "All\0*.*\0Json\0*.json\0";
+	ofn.lpstrFilter = "All\0*.*\0Json\0*.json\0Scene\0*.scene\0";
 	ofn.nFilterIndex = 1;
 	ofn.lpstrFileTitle = NULL;
 	ofn.nMaxFileTitle = 0;
@@ -45,7 +45,7 @@ std::string EditorUtils::saveFileName(std::string ext)
 	ofn.lpstrFile = szFile;
 	ofn.lpstrFile[0] = '\0';
 	ofn.nMaxFile = sizeof(szFile);
-	ofn.lpstrFilter = "All\0*.*\0Json\0*.json\0";
+	ofn.lpstrFilter = "All\0*.*\0Json\0*.json\0Scene\0*.scene\0";
 	ofn.nFilterIndex = 1;
 	ofn.lpstrFileTitle = NULL;
 	ofn.nMaxFileTitle = 0;
@@ -8,7 +8,7 @@
 #include "loguru.hpp"
 #include "registry.h"
 
-int selected = 0;
+Handle selected = 0;
 
 template <typename C> void guiComponent(C &component)
 {
@@ -26,6 +26,13 @@ template <> void guiComponent(Ref &component)
     ImGui::LabelText("Path", component.path.c_str());
 }
 
+template <> void guiComponent(Loading &component)
+{
+    const char *states[] = {"Queued", "Importing", "Finalizing", "Failed"};
+    ImGui::LabelText("State", states[component.state]);
+    ImGui::ProgressBar(component.progress);
+}
+
 template <> void guiComponent(Relation &component)
 {
     ImGui::LabelText("Parent",std::to_string(component.parent).c_str());
@@ -177,6 +184,7 @@ void RegistryView::gui()
         guiComponentType<RenderPassInstance>(selected);
         guiComponentType<Mesh>(selected);
         guiComponentType<Ref>(selected);
+        guiComponentType<Loading>(selected);
     }
     ImGui::End();
 }
@@ -0,0 +1,83 @@
+#ifndef aabbtree_h__
+#define aabbtree_h__
+
+#include "types.h"
+
+#include <functional>
+#include <vector>
+
+// Dynamic bounding volume tree. Leaves store a fattened box so small movements only refit nothing, inserts pick
+// the sibling with the lowest surface area cost and the tree is kept balanced with rotations.
+class AABBTree
+{
+  public:
+    static constexpr int none = -1;
+
+    int insert(const BBox &box, Handle entity);
+    void remove(int leaf);
+
+    // Returns true if the leaf had to be reinserted because box left its fat box.
+    bool update(int leaf, const BBox &box);
+
+    // Nearest leaf box hit by ray that passes filter, 0 if none.
+    Handle raycast(const Ray &ray, float &distance, const std::function<bool(Handle)> &filter = nullptr) const;
+    void overlap(const BBox &box, std::vector<Handle> &out) const;
+    void query(const Frustum &frustum, std::vector<Handle> &out) const;
+
+    size_t size() const
+    {
+        return leaves;
+    }
+
+  private:
+    struct Node
+    {
+        BBox box;
+        BBox tight;
+        Handle entity = 0;
+        int parent = none;
+        int left = none;
+        int right = none;
+        int height = 0;
+
+        bool leaf() const
+        {
+            return left == none;
+        }
+    };
+
+    std::vector<Node> nodes;
+    int root = none;
+    int freeList = none;
+    size_t leaves = 0;
+
+    int allocate();
+    void release(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    int balance(int node);
+    void refit(int node);
+
+    template <typename Test, typename Leaf> void walk(Test &&test, Leaf &&leaf) const
+    {
+        if (root == none)
+            return;
+        std::vector<int> stack{root};
+        while (!stack.empty())
+        {
+            auto &node = nodes[stack.back()];
+            stack.pop_back();
+            if (!test(node.box))
+                continue;
+            if (node.leaf())
+            {
+                leaf(node);
+                continue;
+            }
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+};
+
+#endif // aabbtree_h__
@@ -0,0 +1,180 @@
+#ifndef archetype_h__
+#define archetype_h__
+
+#include "types.h"
+#include "component.h"
+
+#include <array>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+const size_t CHUNK_SIZE = 16 * 1024;
+
+// All entities sharing one exact component signature. Rows are packed into fixed size chunks, each chunk laid
+// out as one array per component type (SoA) plus an array of owning entities.
+class Archetype
+{
+  public:
+    std::vector<int> signature;
+    std::vector<const ComponentType *> types;
+    std::vector<size_t> offsets;
+    std::vector<unsigned char *> chunks;
+    int capacity = 0;
+    int count = 0;
+
+    Archetype(const std::vector<int> &signature);
+    ~Archetype();
+
+    int column(int typeId) const
+    {
+        for (size_t i = 0; i < signature.size(); i++)
+        {
+            if (signature[i] == typeId)
+                return int(i);
+        }
+        return -1;
+    }
+
+    Handle *entities(int chunk) const
+    {
+        return (Handle *)chunks[chunk];
+    }
+
+    void *columnData(int chunk, int col) const
+    {
+        return chunks[chunk] + offsets[col];
+    }
+
+    void *at(int row, int col) const
+    {
+        return (unsigned char *)columnData(row / capacity, col) + types[col]->size * (row % capacity);
+    }
+
+    Handle entity(int row) const
+    {
+        return entities(row / capacity)[row % capacity];
+    }
+
+    int rows(int chunk) const
+    {
+        return std::min(capacity, count - chunk * capacity);
+    }
+
+    // Reserves a row for entity, component columns are left unconstructed.
+    int allocate(Handle entity);
+
+    // Destroys a row and moves the last row into its place, returns the entity that moved or 0.
+    Handle remove(int row);
+
+  private:
+    size_t chunkBytes = CHUNK_SIZE;
+};
+
+class ArchetypeStorage
+{
+  private:
+    struct Location
+    {
+        Archetype *archetype = nullptr;
+        int row = 0;
+    };
+
+    std::map<std::vector<int>, Archetype *> archetypeMap;
+    std::vector<Archetype *> archetypes;
+    std::vector<Location> locations;
+
+    Location *find(Handle entity);
+    Location &location(Handle entity);
+    Archetype *archetype(const std::vector<int> &signature);
+    void move(Handle entity, Archetype *target, const ComponentType *added, const void *value);
+
+    static bool match(Archetype *arch, const int *ids, int *columns, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            columns[i] = arch->column(ids[i]);
+            if (columns[i] < 0)
+                return false;
+        }
+        return true;
+    }
+
+    template <typename... Ts, typename F, size_t... I>
+    void eachInChunk(Archetype *arch, int chunk, const int *columns, F &fn, std::index_sequence<I...>)
+    {
+        auto handles = arch->entities(chunk);
+        auto data = std::make_tuple((Ts *)arch->columnData(chunk, columns[I])...);
+        for (int row = 0; row < arch->rows(chunk); row++)
+        {
+            fn(handles[row], std::get<I>(data)[row]...);
+        }
+    }
+
+  public:
+    ArchetypeStorage();
+    ~ArchetypeStorage();
+
+    ArchetypeStorage *clone();
+
+    void *get(Handle entity, const ComponentType &type);
+    void *emplace(Handle entity, const ComponentType &type);
+    void add(Handle entity, const ComponentType &type, const void *value);
+    void remove(Handle entity, const ComponentType &type);
+    void remove(Handle entity);
+    void copy(Handle source, Handle target);
+
+    std::vector<const ComponentType *> componentTypes(Handle entity);
+    std::vector<Handle> entities(const ComponentType &type);
+    std::vector<Handle> entities();
+
+    // One chunk of an archetype holding all of Ts, with the column of each type.
+    template <typename... Ts> struct Chunk
+    {
+        Archetype *archetype;
+        int chunk;
+        std::array<int, sizeof...(Ts)> columns;
+    };
+
+    template <typename... Ts> std::vector<Chunk<Ts...>> chunks()
+    {
+        const int ids[] = {ComponentType::of<Ts>().id...};
+        std::vector<Chunk<Ts...>> ret;
+        for (auto arch : archetypes)
+        {
+            Chunk<Ts...> chunk{arch};
+            if (!match(arch, ids, chunk.columns.data(), sizeof...(Ts)))
+                continue;
+            for (int c = 0; c < int(arch->chunks.size()) && c * arch->capacity < arch->count; c++)
+            {
+                chunk.chunk = c;
+                ret.push_back(chunk);
+            }
+        }
+        return ret;
+    }
+
+    template <typename... Ts, typename F> void each(const Chunk<Ts...> &chunk, F &&fn)
+    {
+        eachInChunk<Ts...>(chunk.archetype, chunk.chunk, chunk.columns.data(), fn, std::index_sequence_for<Ts...>());
+    }
+
+    template <typename... Ts, typename F> void each(F &&fn)
+    {
+        const int ids[] = {ComponentType::of<Ts>().id...};
+        int columns[sizeof...(Ts)];
+        for (size_t a = 0; a < archetypes.size(); a++)
+        {
+            auto arch = archetypes[a];
+            if (!match(arch, ids, columns, sizeof...(Ts)))
+                continue;
+            for (int c = 0; c < int(arch->chunks.size()) && c * arch->capacity < arch->count; c++)
+            {
+                eachInChunk<Ts...>(arch, c, columns, fn, std::index_sequence_for<Ts...>());
+            }
+        }
+    }
+};
+
+#endif // archetype_h__
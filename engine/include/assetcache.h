@@ -0,0 +1,71 @@
+#ifndef assetcache_h__
+#define assetcache_h__
+
+#include "types.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Protos of imported files, looked up by canonical path or by the hash of the file content so copies of a file
+// share one proto. Every instance created from a proto holds a reference, protos nobody references for EVICT_FRAMES
+// calls of collect() are dropped from the cache and handed back to be destroyed.
+class AssetCache
+{
+  public:
+    static const int EVICT_FRAMES = 300;
+
+    struct Stats
+    {
+        unsigned hits = 0;
+        unsigned misses = 0;
+        unsigned evictions = 0;
+    };
+
+    static std::string canonical(const std::string &path);
+
+    // FNV-1a of the file content, 0 if it can not be read.
+    static uint64_t hashFile(const std::string &path);
+
+    // Proto cached for a canonical path, 0 when there is none. Found protos count as hits.
+    Handle find(const std::string &path);
+
+    // Makes path another name for a cached proto with the same content and returns it, 0 when there is none.
+    Handle alias(const std::string &path, uint64_t hash);
+
+    // Adds the proto of a new import, counted as a miss.
+    void add(const std::string &path, uint64_t hash, Handle proto);
+
+    void acquire(Handle proto);
+    void release(Handle proto);
+
+    // Once per frame, returns the protos evicted by this call.
+    std::vector<Handle> collect();
+
+    const Stats &stats() const
+    {
+        return counters;
+    }
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+  private:
+    struct Entry
+    {
+        uint64_t hash;
+        int refs;
+        int idleFrames;
+        std::vector<std::string> paths;
+    };
+
+    std::unordered_map<std::string, Handle> byPath;
+    std::unordered_map<uint64_t, Handle> byHash;
+    std::unordered_map<Handle, Entry> entries;
+    Stats counters;
+};
+
+#endif // assetcache_h__
@@ -0,0 +1,28 @@
+#ifndef boundsbatch_h__
+#define boundsbatch_h__
+
+#include "types.h"
+
+#include <cstdint>
+
+// World space boxes stored as centers and extents (SoA), tested against a frustum in bulk by cull().
+struct BoundsBatch
+{
+    std::vector<float> cx, cy, cz;
+    std::vector<float> ex, ey, ez;
+
+    size_t size() const
+    {
+        return cx.size();
+    }
+
+    void clear();
+
+    // Empty boxes are pushed with huge extents so they are never culled.
+    void push(const BBox &box);
+
+    // Sets visible[i] to 1 for every box intersecting the frustum, 0 otherwise.
+    void cull(const Frustum &frustum, std::vector<uint8_t> &visible) const;
+};
+
+#endif // boundsbatch_h__
@@ -0,0 +1,58 @@
+#ifndef commandbuffer_h__
+#define commandbuffer_h__
+
+#include "types.h"
+
+#include <new>
+#include <vector>
+
+class Registry;
+
+const size_t COMMAND_BLOCK_SIZE = 16 * 1024;
+
+// Records structural changes into a linear arena so they can be applied in bulk at a sync point, typically once
+// the storages they touch are no longer being iterated.
+class CommandBuffer
+{
+  public:
+    CommandBuffer(Registry *registry);
+    ~CommandBuffer();
+
+    // The handle is reserved right away, components recorded for it are added on playback.
+    Handle createEntity();
+    template <class T> void addComponent(Handle entity, const T &value);
+    template <class T> void removeComponent(Handle entity);
+    void destroy(Handle entity);
+
+    // Applies the recorded commands in order and rewinds the arena.
+    void playback();
+
+    bool empty() const
+    {
+        return !first;
+    }
+
+  private:
+    struct Command
+    {
+        void (*apply)(Registry &registry, Handle entity, void *payload);
+        void (*destroy)(void *payload);
+        Handle entity;
+        void *payload;
+        Command *next;
+    };
+
+    Registry *registry;
+    std::vector<unsigned char *> blocks;
+    std::vector<unsigned char *> large;
+    size_t block = 0;
+    size_t used = 0;
+    Command *first = nullptr;
+    Command *last = nullptr;
+
+    void *allocate(size_t size, size_t align);
+    Command *record(Handle entity, size_t size = 0, size_t align = 1);
+    void clear(bool apply);
+};
+
+#endif // commandbuffer_h__
@@ -0,0 +1,100 @@
+#ifndef component_h__
+#define component_h__
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "serialize.h"
+
+// Type-erased description of a component type, used by storages that pack several component types together.
+struct ComponentType
+{
+    int id;
+    std::string name;
+    size_t size;
+    size_t align;
+    bool serializable;
+
+    void (*construct)(void *dst);
+    void (*copy)(void *dst, const void *src);
+    void (*move)(void *dst, void *src);
+    void (*assign)(void *dst, const void *src);
+    void (*destroy)(void *ptr);
+    void (*serialize)(void *ptr, json &j);
+    void (*unserialize)(void *ptr, json &j);
+    // Writes the fields of after that differ from before, see diffJson.
+    void (*diff)(const void *before, const void *after, json &j);
+    // Fields of serializer(), empty for types without one.
+    std::vector<FieldInfo> fields;
+
+    template <class C> static const ComponentType &of();
+
+    static const ComponentType *find(const std::string &name);
+    static const ComponentType *byId(int id);
+
+  private:
+    static std::vector<ComponentType *> *_types;
+    static std::map<std::string, ComponentType *> *_names;
+    static const ComponentType *add(ComponentType *type);
+};
+
+// Default constructed component of a runtime type, for decoding data before it is stored anywhere.
+struct ScratchComponent
+{
+    const ComponentType &type;
+    std::unique_ptr<std::max_align_t[]> storage;
+
+    ScratchComponent(const ComponentType &type)
+        : type(type), storage(new std::max_align_t[(type.size + sizeof(std::max_align_t) - 1) /
+                                                   sizeof(std::max_align_t)])
+    {
+        type.construct(storage.get());
+    }
+
+    ~ScratchComponent()
+    {
+        type.destroy(storage.get());
+    }
+
+    void *get()
+    {
+        return storage.get();
+    }
+};
+
+template <class C> const ComponentType &ComponentType::of()
+{
+    static const ComponentType *type = add(new ComponentType{
+        0,
+        typeid(C).name(),
+        sizeof(C),
+        alignof(C),
+        ::isSerializable<C>(),
+        [](void *dst) { new (dst) C(); },
+        [](void *dst, const void *src) { new (dst) C(*(const C *)src); },
+        [](void *dst, void *src) { new (dst) C(std::move(*(C *)src)); },
+        [](void *dst, const void *src) { *(C *)dst = *(const C *)src; },
+        [](void *ptr) { ((C *)ptr)->~C(); },
+        [](void *ptr, json &j) {
+            if constexpr (::isSerializable<C>())
+                writeJson(*(const C *)ptr, j);
+        },
+        [](void *ptr, json &j) {
+            if constexpr (::isSerializable<C>())
+                readJson(*(C *)ptr, j);
+        },
+        [](const void *before, const void *after, json &j) {
+            if constexpr (::isSerializable<C>())
+                diffJson(*(const C *)before, *(const C *)after, j);
+        },
+        fieldInfos<C>(),
+    });
+    return *type;
+}
+
+#endif // component_h__
@@ -14,7 +14,7 @@ struct Info
     int scope=0;
     bool active = true;
 
-    static Encoder serializer()
+    static constexpr auto serializer()
     {
         return serialize(
             "name", &Info::name, 
@@ -28,7 +28,7 @@ struct Ref
 {
     std::string path;
 
-    static Encoder serializer()
+    static constexpr auto serializer()
     {
         return serialize("ref", &Ref::path);
     }
@@ -38,7 +38,7 @@ REGISTER_COMPONENT(Ref)
 struct Proto
 {
     std::string path;
-    static Encoder serializer()
+    static constexpr auto serializer()
     {
         return serialize("proto", &Proto::path);
     }
@@ -50,6 +50,21 @@ struct Instance
 };
 REGISTER_COMPONENT(Instance)
 
+// Placeholder state of a Ref whose file is still being imported by LoadSys, removed once it is instantiated.
+struct Loading
+{
+    enum State
+    {
+        Queued,
+        Importing,
+        Finalizing,
+        Failed
+    } state = Queued;
+    // Share of the import jobs done, from 0 to 1.
+    float progress = 0;
+};
+REGISTER_COMPONENT(Loading)
+
 struct Relation
 {
     Handle parent;
@@ -59,7 +74,7 @@ struct Relation
     {      
         children.push_back(handle);
     }
-    static Encoder serializer()
+    static constexpr auto serializer()
     {
         return serialize(
             "parent", &Relation::parent, 
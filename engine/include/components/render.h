@@ -183,68 +183,13 @@ struct Geometry
         addShape(color, transform, &vertices[0].x, vertices.size(), nullptr, 0);
     }
 
-//     void addBBox(BBox &bbox, mat4 transform = glm::identity<mat4>(), Color color = Color::white)
-//     {
-//         addBox(bbox.min, bbox.max, transform, color);
-//     }    
-
-    void addBBox(BBox &bbox, mat4 transform = glm::identity<mat4>(), Color color = Color::white)
-    {
-        const float w = 0.025;
-        vec3 vs[] = {bbox.min, bbox.max};
-        for (auto h : {0, 1})
-        {
-            addLineStrip(
-                {
-                    vec3(vs[0].x, vs[h].y, vs[0].z),
-                    vec3(vs[0].x, vs[h].y, vs[1].z),
-                    vec3(vs[1].x, vs[h].y, vs[1].z),
-                    vec3(vs[1].x, vs[h].y, vs[0].z),
-                },
-                color, w, transform);
-        }
-        addLineSegment(vec3(bbox.min.x, bbox.max.y, bbox.min.z), vec3(bbox.min.x, bbox.min.y, bbox.min.z), color, w,
-                       transform);
-        addLineSegment(vec3(bbox.min.x, bbox.max.y, bbox.max.z), vec3(bbox.min.x, bbox.min.y, bbox.max.z), color, w,
-                       transform);
-        addLineSegment(vec3(bbox.max.x, bbox.max.y, bbox.max.z), vec3(bbox.max.x, bbox.min.y, bbox.max.z), color, w,
-                       transform);
-        addLineSegment(vec3(bbox.max.x, bbox.max.y, bbox.min.z), vec3(bbox.max.x, bbox.min.y, bbox.min.z), color, w,
-                       transform);
-    }
-
-    void addLineSegment(vec3 a, vec3 b, Color color = Color::white, float width = 0.1f,
-                        mat4 transform = glm::identity<mat4>())
-    {
-        a = transform * vec4(a, 1);
-        b = transform * vec4(b, 1);
-        auto d = glm::normalize(b - a);
-        mat4 rot = glm::identity<mat4>(); 
-        if (!glm::all(glm::epsilonEqual(vec3(0, 0, 1), glm::abs(d), glm::epsilon<float>())))
-        {
-            auto ax = glm::cross(vec3(0, 0, 1), d);
-            auto angle = glm::angle(vec3(0, 0, 1), d);
-            rot = glm::rotate(angle, ax);
-        }
-        mat4 t = glm::translate((a+b)*0.5f) * rot * glm::scale(vec3(width, width, glm::length(a-b)));
-        addBox(t, color);
-    }
-
-    void addLineStrip(std::vector<vec3> v, vec4 color = Color::white, float width = 0.1f,
-                      mat4 transform = glm::identity<mat4>())
-    {
-        for (size_t i = 0; i < v.size(); i++)
-        {
-            addLineSegment(v[i], v[(i + 1) % v.size()], color, width, transform);
-        }
-    }
-
     void addPath(std::vector<vec3> points, Color color = Color::white)
     {
     }
 
-    void addCircle(vec3 center, float r, float width = 0.1f, mat4 transform = glm::identity<mat4>(), 
-        Color color = Color::white, bool filled=false, float startAngle=0, float endAngle = PI*2)
+    // Filled arc of 24 triangles around center from startAngle to endAngle, in the xy plane of transform.
+    void addFilledArc(vec3 center, float r, mat4 transform = glm::identity<mat4>(), Color color = Color::white,
+                      float startAngle = 0, float endAngle = PI * 2)
     {
         int segments = 24;
         float da = endAngle - startAngle;
@@ -254,16 +199,7 @@ struct Geometry
             auto b = ((i + 1) * da) / segments + startAngle;
             auto start = vec4(glm::cos(a)*r, glm::sin(a)*r, 0, 1.0);
             auto end = vec4(glm::cos(b)*r, glm::sin(b)*r, 0, 1.0);
-            if (width > 0)
-            {
-                addLineSegment((transform * start) + vec4(center, 0.0f),
-                               (transform * end) + vec4(center, 0.0), color,
-                               width);
-            }
-            if (filled)
-            {
-                addPoly(color, glm::translate(center) * transform, std::vector<vec3>{start, end, vec3(0.0f)});
-            }
+            addPoly(color, glm::translate(center) * transform, std::vector<vec3>{start, end, vec3(0.0f)});
         }
     }
 
@@ -331,13 +267,53 @@ struct GLTexture
 };
 REGISTER_COMPONENT(GLTexture)
 
+// Vertex attribute holding the per instance model matrix of instanced programs, takes four locations.
+const GLuint INSTANCE_MODEL_LOCATION = 4;
+
+// Binding points of the std140 uniform blocks declared by the shaders, assigned to every program in createPipeline.
+enum UniformBlockBinding
+{
+    CAMERA_BLOCK = 0,
+    PASS_BLOCK   = 1,
+    DRAW_BLOCK   = 2,
+    UNIFORM_BLOCK_COUNT
+};
+
+extern const char *UniformBlockNames[];
+
+// Uploaded once per render pass.
+struct CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+};
+
+// Constant for the whole run, std140 pads every vec3 array element to 16 bytes.
+struct PassBlock
+{
+    vec4 ssaoKernel[64];
+};
+
+// One per draw, bound with glBindBufferRange at an offset aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+struct DrawBlock
+{
+    mat4 model;
+    vec4 diffuseColor;
+};
+
 struct GLPipeline
 {
     Pipeline info;
-    GLuint programName;
+    GLuint programName = 0;
     short uniforms[16];
     short attachments[16];
     short attributes[16];
+    // Variant reading the model matrix from INSTANCE_MODEL_LOCATION, 0 when the pipeline has none.
+    GLuint instancedProgramName = 0;
+    short instancedUniforms[16];
+    // Variant expanding DebugDraw segments into quads, 0 when the pipeline has none.
+    GLuint linesProgramName = 0;
+    short linesUniforms[16];
 };
 REGISTER_COMPONENT(GLPipeline)
 
@@ -424,6 +400,8 @@ struct GLGeometry
     GLuint vao;
     GLenum type;
     GLuint count;
+    // Byte offset of the indices in indexbuffer, only dynamic geometries stream them at varying offsets.
+    size_t indexOffset = 0;
 };
 REGISTER_COMPONENT(GLGeometry)
 
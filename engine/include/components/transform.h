@@ -10,7 +10,10 @@ struct Transform
     quat rotation = glm::identity<quat>();
     vec3 scaling = vec3(1.0f);
 
-    mat4 parentWorldTransform = glm::identity<mat4>();
+    // Kept up to date by TransformSys, which only recomputes it when the local values or a parent changed. The
+    // revision is bumped every time it does.
+    mat4 world = glm::identity<mat4>();
+    unsigned revision = 0;
 
     Transform()
     {
@@ -19,6 +22,7 @@ struct Transform
     Transform(vec3 position, quat rotation, vec3 scaling)
         : position(position), rotation(rotation), scaling(scaling)
     {    
+        world = matrix();
     }
 
     mat4 matrix() const
@@ -33,9 +37,19 @@ struct Transform
         glm::decompose(matrix, scaling, rotation, position, skew, perspective); 
     }
 
-    mat4 worldMatrix()
+    // The world matrix as of the last TransformSys run. Code that writes a Transform and needs the world matrix of
+    // it or of its children in the same frame, like the editor gizmos, uses TransformSys::currentWorld() instead.
+    const mat4 &worldMatrix() const
     {
-        return parentWorldTransform *matrix();
+        return world;
+    }
+
+    static constexpr auto serializer()
+    {
+        return serialize(
+            "position", &Transform::position, 
+            "rotation", &Transform::rotation, 
+            "scaling", &Transform::scaling);
     }
 };
 REGISTER_COMPONENT(Transform)
@@ -0,0 +1,62 @@
+#ifndef debugdraw_h__
+#define debugdraw_h__
+
+#include "types.h"
+
+#include <unordered_map>
+#include <vector>
+
+class Registry;
+
+// Immediate mode overlay lines, recorded during the frame and drawn by RenderSys in the subpasses whose pipeline
+// has a lines variant and includes the layer. Every segment is expanded to a quad of the given world width on the
+// GPU. The per layer arrays keep their capacity across frames, so steady state recording does not allocate.
+// There is one per registry, so the editor and a game running inside it each draw only their own lines. Main thread
+// only.
+class DebugDraw
+{
+  public:
+    // Matches the per instance attributes of the lines shader variants.
+    struct Segment
+    {
+        vec3 a;
+        float width;
+        vec3 b;
+        float reserved;
+        vec4 color;
+    };
+
+    struct Layer
+    {
+        int mask;
+        std::vector<Segment> segments;
+    };
+
+    void line(int layer, vec3 a, vec3 b, vec4 color = Color::white, float width = 0.1f);
+
+    // The twelve edges of box, transformed by transform.
+    void box(int layer, const BBox &box, const mat4 &transform = glm::identity<mat4>(), vec4 color = Color::white,
+             float width = 0.025f);
+
+    // Same placement as Geometry::addFilledArc, an arc of 24 segments from startAngle to endAngle.
+    void circle(int layer, vec3 center, float r, const mat4 &transform = glm::identity<mat4>(),
+                vec4 color = Color::white, float width = 0.1f, float startAngle = 0, float endAngle = PI * 2);
+
+    const std::vector<Layer> &layers() const
+    {
+        return recorded;
+    }
+
+    // Called by the RenderSys of the registry once the frame is drawn.
+    void clear();
+
+    static DebugDraw *of(Registry *registry);
+
+  private:
+    static std::unordered_map<Registry *, DebugDraw> *_instances;
+    std::vector<Layer> recorded;
+
+    std::vector<Segment> &segments(int layer);
+};
+
+#endif // debugdraw_h__
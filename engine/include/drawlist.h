@@ -0,0 +1,44 @@
+#ifndef drawlist_h__
+#define drawlist_h__
+
+#include "types.h"
+
+#include <cstdint>
+
+struct Geometry;
+struct GLGeometry;
+
+// One draw of a subpass. The key orders draws by pipeline, material, vertex array and front to back depth so that
+// draws sharing state end up next to each other.
+struct DrawItem
+{
+    uint64_t key;
+    const mat4 *model;
+    const Geometry *geometry;
+    const GLGeometry *glGeometry;
+};
+
+struct DrawList
+{
+    std::vector<DrawItem> items;
+
+    static uint64_t makeKey(unsigned pipeline, Handle material, unsigned vao, float depth);
+
+    void clear()
+    {
+        items.clear();
+    }
+
+    void push(uint64_t key, const mat4 *model, const Geometry *geometry, const GLGeometry *glGeometry)
+    {
+        items.push_back({key, model, geometry, glGeometry});
+    }
+
+    // LSD radix sort on the keys, passes over bytes every item shares are skipped.
+    void sort();
+
+  private:
+    std::vector<DrawItem> scratch;
+};
+
+#endif // drawlist_h__
@@ -2,6 +2,7 @@
 #define Engine_h__
 
 #include "registry.h"
+#include "scheduler.h"
 
 #include <vector>
 #include <map>
@@ -14,6 +15,8 @@ class Engine
 {
 private:
     static Engine* _instance;
+    Scheduler scheduler;
+    bool scheduleDirty = true;
 public:
     std::vector<System*> systems;
     Registry registry;
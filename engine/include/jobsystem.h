@@ -0,0 +1,74 @@
+#ifndef jobsystem_h__
+#define jobsystem_h__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a deque, it pops its own jobs from the back and steals from the
+// front of the others when it runs dry. Threads that are not workers push into queue 0.
+class JobSystem
+{
+  public:
+    typedef std::function<void(void)> Job;
+
+    JobSystem(int workerCount);
+    ~JobSystem();
+
+    // Queues a job. If counter is given it is incremented now and decremented once the job has run.
+    void submit(Job job, std::atomic<int> *counter = nullptr);
+
+    // Runs queued jobs on the calling thread until counter drops to zero.
+    void wait(std::atomic<int> &counter);
+
+    // Runs one queued job on the calling thread, returns false if there was nothing to do.
+    bool runOne();
+
+    int workerCount() const
+    {
+        return int(threads.size());
+    }
+
+    // Index of the calling worker starting at 1, 0 for threads that are not workers.
+    static int currentThread()
+    {
+        return workerIndex;
+    }
+
+    static JobSystem *instance();
+
+  private:
+    struct Entry
+    {
+        Job job;
+        std::atomic<int> *counter;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Entry> entries;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<bool> quit{false};
+    std::atomic<int> queued{0};
+    std::atomic<unsigned> next{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    static JobSystem *_instance;
+    static thread_local int workerIndex;
+
+    bool pop(Entry &entry);
+    void run(Entry &entry);
+    void workerLoop(int index);
+};
+
+#endif // jobsystem_h__
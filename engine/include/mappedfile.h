@@ -0,0 +1,46 @@
+#ifndef mappedfile_h__
+#define mappedfile_h__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read only view of a whole file, memory mapped where the platform supports it so readers can copy straight out of
+// the page cache. Falls back to reading the file into memory under emscripten.
+class MappedFile
+{
+  public:
+    MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const uint8_t *data() const
+    {
+        return bytes;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    bool valid() const
+    {
+        return bytes != nullptr;
+    }
+
+  private:
+    const uint8_t *bytes = nullptr;
+    size_t length = 0;
+#if defined(_WIN32)
+    void *file = nullptr;
+    void *mapping = nullptr;
+#elif defined(EMSCRIPTEN)
+    std::vector<uint8_t> buffer;
+#endif
+};
+
+#endif // mappedfile_h__
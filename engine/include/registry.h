@@ -2,9 +2,26 @@
 #define Registry_h__
 
 #include "Storage.h"
+#include "archetype.h"
+#include "view.h"
+#include "jobsystem.h"
+#include "commandbuffer.h"
 
+#include <atomic>
 #include <functional>
 #include <map>
+#include <mutex>
+#include <stdexcept>
+#include <typeindex>
+#include <unordered_map>
+
+// Entities per job when par_each splits a storage or view.
+const size_t PAR_EACH_GRAIN = 1024;
+static_assert(PAR_EACH_GRAIN % STORAGE_PAGE_SIZE == 0, "par_each jobs must not share storage pages");
+
+// Binary scene files start with this magic and version, readers reject newer versions.
+const uint32_t SCENE_BINARY_MAGIC = 0x42534345;
+const uint32_t SCENE_BINARY_VERSION = 1;
 
 struct EntityInfo
 {
@@ -12,18 +29,134 @@ struct EntityInfo
     std::vector<std::string> components;
 };
 
+template <typename... Ts> class View;
+
+// Told about every component and entity of a registry about to change, while it still has its old value. Calls
+// come from the main thread, or from par_each workers under the entity lock when they create entities.
+struct ChangeListener
+{
+    virtual void componentChanging(Handle entity, const ComponentType &type) = 0;
+    virtual void entityChanging(Handle entity, bool alive) = 0;
+};
+
 class Registry
 {
+  public:
+    enum class Backend
+    {
+        Sparse,
+        Archetype
+    };
+
   private:
     std::map<std::string, StorageBase *> storages;
-    int entityCounter = 1;
+    std::vector<StorageBase *> storageIndex;
+    ArchetypeStorage *archetypes = nullptr;
+    uint32_t entityCounter = 1;
+    std::vector<uint32_t> generations;
+    // Newest generation each index was given out with, revive() can set generations back below it.
+    std::vector<uint32_t> newestGenerations;
+    std::vector<bool> alive;
+    std::vector<uint32_t> freeIndices;
     std::vector<Handle> released;
+    size_t destroyed = 0;
+    std::unordered_map<std::type_index, ViewBase *> views;
+    std::vector<std::vector<ViewBase *>> componentViews;
+    std::atomic<int> parallelDepth{0};
+    // Guards the free list and released, entities are created and released from par_each chunks and worker systems.
+    std::mutex entityMutex;
+    // Guards views and componentViews, worker systems create views while the main thread updates them.
+    std::mutex viewMutex;
+    std::vector<CommandBuffer *> threadCommands;
+    ChangeListener *listener = nullptr;
+
+    template <class T> T *component(Handle id)
+    {
+        if (archetypes)
+            return static_cast<T *>(archetypes->get(id, ComponentType::of<T>()));
+        return storage<T>()->get(id);
+    }
+
+    void notify(int typeId, Handle entity)
+    {
+        std::lock_guard<std::mutex> lock(viewMutex);
+        if (typeId < int(componentViews.size()))
+        {
+            for (auto view : componentViews[typeId])
+                view->update(entity);
+        }
+    }
+
+    void notifyAll(Handle entity)
+    {
+        std::lock_guard<std::mutex> lock(viewMutex);
+        for (auto &kv : views)
+            kv.second->update(entity);
+    }
+
+    // Registry whose par_each chunk the calling thread is running, if any.
+    static thread_local Registry *walking;
+
+    struct ChunkScope
+    {
+        Registry *previous;
+
+        ChunkScope(Registry *registry) : previous(walking)
+        {
+            walking = registry;
+        }
+
+        ~ChunkScope()
+        {
+            walking = previous;
+        }
+    };
+
+    // Structural changes made by par_each chunks go to the command buffer of their thread and are played back once
+    // the chunks have joined. Other threads, like main thread systems running meanwhile, apply them right away.
+    CommandBuffer *deferred()
+    {
+        return walking == this ? threadCommands[JobSystem::currentThread()] : nullptr;
+    }
+
+    void flushDeferred();
+
+    void changing(Handle entity, const ComponentType &type)
+    {
+        if (listener)
+            listener->componentChanging(entity, type);
+    }
+
+    // Reports every component of an entity about to be destroyed.
+    void removing(Handle entity);
+
+    // Walks a binary scene, only decoding it unless apply is set.
+    void readScene(const uint8_t *data, size_t size, bool apply);
+
+    void recycle(Handle entity)
+    {
+        std::lock_guard<std::mutex> lock(entityMutex);
+        if (valid(entity))
+        {
+            auto index = handleIndex(entity);
+            generations[index] = ++newestGenerations[index];
+            alive[index] = false;
+            freeIndices.push_back(index);
+        }
+    }
 
   public:
-    Registry(/* args */);
+    Registry(Backend backend = Backend::Sparse);
     ~Registry();
 
+    // Destroys every entity queued by release() and frees storage pages replaced by copies, once per frame after all
+    // systems have run.
     void cleanUp();
+
+    size_t destroyedLastFrame() const
+    {
+        return destroyed;
+    }
 	
     StorageBase *storage(const std::string& typeName)
     {
@@ -35,48 +168,121 @@ class Registry
         return storages[id];
     }
 
+    // Creates the storage of every registered component type and indexes it. The engine calls it before systems
+    // run in parallel, so storage<T>() on a type registered by then never changes the containers it reads.
+    void createStorages();
+
+    // Typed lookups go through the component id, the name map is only used by serialization.
     template <class T> Storage<T> *storage()
     {
-        std::string id = typeid(T).name();
-        return static_cast<Storage<T> *>(storage(id));
+        auto id = ComponentType::of<T>().id;
+        if (id >= int(storageIndex.size()))
+        {
+            storageIndex.resize(size_t(id) + 1, nullptr);
+        }
+        auto &st = storageIndex[id];
+        if (!st)
+        {
+            st = storage(typeid(T).name());
+        }
+        return static_cast<Storage<T> *>(st);
     }
 
-    Handle nextEntityId()
+    Handle nextEntityId();
+    void claim(Handle entity);
+    // Brings a destroyed entity back under its handle, false when its index belongs to another entity by now. The
+    // index keeps counting from the newest generation it had, so no handle given out meanwhile is given out again.
+    bool revive(Handle entity);
+
+    bool valid(Handle entity) const
     {
-        return entityCounter++;
+        auto index = handleIndex(entity);
+        return index < generations.size() && alive[index] && generations[index] == handleGeneration(entity);
     }
 
     Handle copy(Handle source, Handle target)
     {
+        if (listener)
+        {
+            for (auto type : componentTypes(source))
+                changing(target, *type);
+        }
+        if (archetypes)
+        {
+            archetypes->copy(source, target);
+            notifyAll(target);
+            return target;
+        }
         for (auto storage : storages)
         {
             storage.second->copy(source, target);
         }
+        notifyAll(target);
         return target;
     }
 
+    // Sparse storages share their pages with reg until either side writes to them, archetypes are copied.
     void copyFrom(Registry& reg)
     {
+        if (reg.archetypes)
+        {
+            delete archetypes;
+            archetypes = reg.archetypes->clone();
+        }
+        for (auto &st : storages)
+        {
+            delete st.second;
+        }
+        storages.clear();
         for (auto st : reg.storages)
         {
             storages[st.first] = st.second->clone();
         }
+        storageIndex.clear();
+        createStorages();
         entityCounter = reg.entityCounter;
+        generations = reg.generations;
+        newestGenerations = reg.newestGenerations;
+        alive = reg.alive;
+        freeIndices = reg.freeIndices;
+        std::lock_guard<std::mutex> lock(viewMutex);
+        for (auto &kv : views)
+            kv.second->rebuild();
     }
 
-    template <class T> void addComponent(int entityId, T v)
+    template <class T> void addComponent(Handle entityId, T v)
     {
-        storage<T>()->add(entityId, v);
+        if (auto commands = deferred())
+        {
+            commands->addComponent(entityId, v);
+            return;
+        }
+        changing(entityId, ComponentType::of<T>());
+        if (archetypes)
+            archetypes->add(entityId, ComponentType::of<T>(), &v);
+        else
+            storage<T>()->add(entityId, v);
+        notify(ComponentType::of<T>().id, entityId);
     };
 
-    template <class T> void removeComponent(int entityId)
+    template <class T> void removeComponent(Handle entityId)
     {
-        storage<T>()->remove(entityId);
+        if (auto commands = deferred())
+        {
+            commands->removeComponent<T>(entityId);
+            return;
+        }
+        changing(entityId, ComponentType::of<T>());
+        if (archetypes)
+            archetypes->remove(entityId, ComponentType::of<T>());
+        else
+            storage<T>()->remove(entityId);
+        notify(ComponentType::of<T>().id, entityId);
     };
 
-    template <typename T, typename... Args> void addComponent(int entityId, T v, Args... args)
+    template <typename T, typename... Args> void addComponent(Handle entityId, T v, Args... args)
     {
-        storage<T>()->add(entityId, v);
+        addComponent(entityId, v);
         addComponent(entityId, args...);
     };
 
@@ -89,53 +295,77 @@ class Registry
 
     void removeEntity(Handle handle)
     {
+        if (auto commands = deferred())
+        {
+            commands->destroy(handle);
+            return;
+        }
+        removing(handle);
+        if (archetypes)
+            archetypes->remove(handle);
         for (auto storage : storages)
         {
             storage.second->remove(handle);
         }
+        notifyAll(handle);
+        recycle(handle);
     }
 
-    template <typename First, typename F> void entity_impl(int id, F &&callback)
+    template <typename First, typename F> void entity_impl(Handle id, F &&callback)
     {
-        auto comp = storage<First>()->get(id);
+        auto comp = component<First>(id);
         if (comp)            
             callback(*comp);
     }
 
-    template <typename First, typename Second, typename... Rest, typename F> void entity_impl(int id, F &&callback)
+    template <typename First, typename Second, typename... Rest, typename F> void entity_impl(Handle id, F &&callback)
     {
-        auto comp = storage<First>()->get(id);
+        auto comp = component<First>(id);
         if (!comp)
             return;
         entity_impl<Second, Rest...>(id, [&](Second &sec, Rest &... args) { callback(*comp, sec, args...); });
     }
 
-    template <typename... Rest, typename F> void entity(int id, F &&callback)
+    template <typename... Rest, typename F> void entity(Handle id, F &&callback)
     {
-        entity_impl<Rest...>(id, std::function<void(Rest & ...)>(callback));
+        entity_impl<Rest...>(id, callback);
     }
 
-    template <typename First> const std::tuple<First &> getEntity(int id)
+    template <typename First> const std::tuple<First &> getEntity(Handle id)
     {
-        First &comp = *storage<First>()->get(id);
+        First &comp = *component<First>(id);
         return std::forward_as_tuple<First &>(comp);
     }
 
     template <typename First, typename Second, typename... Args>
-    const std::tuple<First &, Second &, Args &...> getEntity(int id)
+    const std::tuple<First &, Second &, Args &...> getEntity(Handle id)
     {
-        First &comp = *storage<First>()->get(id);
+        First &comp = *component<First>(id);
         return std::tuple_cat(std::forward_as_tuple<First &>(comp), getEntity<Second, Args...>(id));
     }
 
-    template <typename T> bool has(int id)
+    // getEntity() for reading, the components must exist.
+    template <typename... Ts> const std::tuple<const Ts &...> readEntity(Handle id)
+    {
+        return std::tuple<const Ts &...>(*read<Ts>(id)...);
+    }
+
+    template <typename T> bool has(Handle id)
+    {
+        return read<T>(id) != nullptr;
+    }
+
+    // Read only lookups, unlike get() they never copy a page shared with a registry clone.
+    template <typename T> const T *read(Handle id)
     {
-        return storage<T>()->get(id) != nullptr;
+        if (archetypes)
+            return static_cast<const T *>(archetypes->get(id, ComponentType::of<T>()));
+        return storage<T>()->read(id);
     }
 
-    template <typename T> bool get(int id, T &val)
+    template <typename T> bool get(Handle id, T &val)
     {
-        if (auto comp = storage<T>()->get(id))
+        if (auto comp = read<T>(id))
         {
             val = *comp;
             return true;
@@ -145,6 +375,8 @@ class Registry
 
     template <typename T> std::vector<Handle> findAll()
     {
+        if (archetypes)
+            return archetypes->entities(ComponentType::of<T>());
         return storage<T>()->entities();
     }
 
@@ -153,32 +385,36 @@ class Registry
         auto ret = std::map<Handle, T *>();
         for (auto handle: entities)
         {
-            if (auto c = storage<T>()->get(handle))
+            if (auto c = component<T>(handle))
                 ret[handle] = c;
         }
         return ret;
     }
 
-    template <typename T> T &get(int id)
+    // Adds a default T when missing. Like every component reference, the result is invalidated by the next add or
+    // remove of T on any entity.
+    template <typename T> T &get(Handle id)
     {
-        auto ptr = storage<T>()->get(id);
+        auto ptr = component<T>(id);
         if (!ptr)
         {
-            auto v = T();
-            storage<T>()->add(id, v);
-            ptr = storage<T>()->get(id);
+            // Inside a par_each chunk the add would only be recorded, there is nothing to return yet.
+            if (walking == this)
+                throw std::logic_error("Registry::get can not add a component inside par_each");
+            addComponent(id, T());
+            ptr = component<T>(id);
         }
         return *ptr;
     }
 
-    template <typename T> T* getPtr(int id)
+    template <typename T> T* getPtr(Handle id)
     {
-        return storage<T>()->get(id);
+        return component<T>(id);
     }
 
-    template <typename T, typename... Rest> bool get(int id, T &val, Rest &... args)
+    template <typename T, typename... Rest> bool get(Handle id, T &val, Rest &... args)
     {
-        if (auto comp = storage<T>()->get(id))
+        if (auto comp = read<T>(id))
         {
             val = *comp;
             return get<Rest...>(id, args...);
@@ -188,21 +424,232 @@ class Registry
 
     template <typename T, typename S, typename... Rest, typename F> void each(F &&callback)
     {
-        storage<T>()->forEach(
-            [&](int id, T &value) { 
-                entity<S, Rest...>(id, [&](S& value2, Rest &... args) { 
-                    callback(id, value, value2, args...); 
-                }); 
-            });
+        if (archetypes)
+        {
+            archetypes->each<T, S, Rest...>(callback);
+            return;
+        }
+        view<T, S, Rest...>().each(callback);
+    }
+
+    template <typename... Ts> View<Ts...> &view();
+
+    // Like each(), but the matching entities are split into chunks processed on the job system. The callback runs
+    // concurrently and may only touch the components it is handed, structural changes are deferred to the join and
+    // get() throws instead of adding a missing component.
+    template <typename T, typename... Rest, typename F> void par_each(F &&callback)
+    {
+        auto jobs = JobSystem::instance();
+        std::atomic<int> counter{0};
+        parallelDepth++;
+        if (archetypes)
+        {
+            for (auto &chunk : archetypes->chunks<T, Rest...>())
+            {
+                jobs->submit(
+                    [&, chunk]() {
+                        ChunkScope scope(this);
+                        archetypes->each(chunk, callback);
+                    },
+                    &counter);
+            }
+        }
+        else if constexpr (sizeof...(Rest) == 0)
+        {
+            auto st = storage<T>();
+            auto count = st->size();
+            for (size_t begin = 0; begin < count; begin += PAR_EACH_GRAIN)
+            {
+                auto end = std::min(begin + PAR_EACH_GRAIN, count);
+                jobs->submit(
+                    [&, st, begin, end]() {
+                        ChunkScope scope(this);
+                        st->forEach(begin, end, callback);
+                    },
+                    &counter);
+            }
+        }
+        else
+        {
+            auto v = &view<T, Rest...>();
+            auto count = v->size();
+            for (size_t begin = 0; begin < count; begin += PAR_EACH_GRAIN)
+            {
+                auto end = std::min(begin + PAR_EACH_GRAIN, count);
+                jobs->submit(
+                    [&, v, begin, end]() {
+                        ChunkScope scope(this);
+                        v->each(begin, end, callback);
+                    },
+                    &counter);
+            }
+        }
+        jobs->wait(counter);
+        if (--parallelDepth == 0)
+            flushDeferred();
     }
 
     template <typename T, typename F> void each(F&& callback)
     {
-        storage<T>()->forEach([&](int id, T &value) { callback(id, value); });
+        if (archetypes)
+        {
+            archetypes->each<T>(callback);
+            return;
+        }
+        storage<T>()->forEach([&](Handle id, T &value) { callback(id, value); });
+    }
+
+    // each() handing out const components, for systems that only read them.
+    template <typename T, typename... Rest, typename F> void readEach(F &&callback)
+    {
+        if (archetypes)
+            archetypes->each<T, Rest...>(callback);
+        else if constexpr (sizeof...(Rest) == 0)
+            storage<T>()->forEachRead([&](Handle id, const T &value) { callback(id, value); });
+        else
+            view<T, Rest...>().read(callback);
     }
+
     std::map<Handle, EntityInfo> entities();
     void release(Handle entity);
-    void toJson(std::vector<int> &entities, json &out);
+    void toJson(std::vector<Handle> &entities, json &out);
     void fromJson(json &j);
+
+    // Type-erased access for code that only knows component types at runtime. emplaceComponent default constructs
+    // a missing component, none of them update views, see loaded().
+    const void *rawComponent(Handle entity, const ComponentType &type);
+    void *emplaceComponent(Handle entity, const ComponentType &type);
+    void removeComponent(Handle entity, const ComponentType &type);
+    std::vector<const ComponentType *> componentTypes(Handle entity);
+
+    // Reports changes to listener until it is replaced, nullptr stops reporting.
+    void listen(ChangeListener *listener)
+    {
+        this->listener = listener;
+    }
+
+    // Components changed through references are not seen by the listener, touch them before writing.
+    template <typename T> void touch(Handle entity)
+    {
+        changing(entity, ComponentType::of<T>());
+    }
+    void touch(Handle entity)
+    {
+        if (listener)
+        {
+            for (auto type : componentTypes(entity))
+                changing(entity, *type);
+        }
+    }
+
+    // The steps of fromJson for loaders that stream the file: claim() the entity, add its components, then update
+    // the views once it is complete.
+    void componentFromJson(Handle entity, const std::string &typeName, json &j);
+    void loaded(Handle entity)
+    {
+        notifyAll(entity);
+    }
+
+    // Binary scene format: one column block per component type, rows laid out by the serializer() fields. Fields
+    // that are plain bytes in memory are copied as they are, the rest use a length prefixed encoding. Columns and
+    // fields unknown to this build are skipped, fields whose size changed are left default constructed.
+    void toBinary(std::vector<Handle> &entities, std::vector<uint8_t> &out);
+    // Throws std::runtime_error on data that is truncated or not a scene, leaving the registry as it was.
+    void fromBinary(const uint8_t *data, size_t size);
+    bool saveBinary(std::vector<Handle> &entities, const std::string &path);
+    // Maps the file and reads it in place.
+    bool loadBinary(const std::string &path);
+};
+
+template <typename... Ts> class View : public ViewBase
+{
+  private:
+    Registry *registry;
+
+  public:
+    View(Registry *registry) : registry(registry)
+    {
+        rebuild();
+    }
+
+    bool matches(Handle entity) override
+    {
+        return (registry->has<Ts>(entity) && ...);
+    }
+
+    void rebuild() override
+    {
+        using First = std::tuple_element_t<0, std::tuple<Ts...>>;
+        dense.clear();
+        sparse.clear();
+        for (auto entity : registry->findAll<First>())
+        {
+            update(entity);
+        }
+    }
+
+    // Walks a copy of the matches, so callbacks may add and remove components: entities that stop matching are
+    // skipped and entities that start matching are not visited. The references handed to a callback are only valid
+    // until it adds or removes one of Ts.
+    template <typename F> void each(F &&fn)
+    {
+        WalkCopy walk(dense);
+        for (auto entity : walk.entities)
+        {
+            if (contains(entity))
+                fn(entity, *registry->getPtr<Ts>(entity)...);
+        }
+    }
+
+    template <typename F> void each(size_t begin, size_t end, F &&fn)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            Handle entity = dense[i];
+            fn(entity, *registry->getPtr<Ts>(entity)...);
+        }
+    }
+
+    template <typename F> void read(F &&fn)
+    {
+        WalkCopy walk(dense);
+        for (auto entity : walk.entities)
+        {
+            if (contains(entity))
+                fn(entity, *registry->read<Ts>(entity)...);
+        }
+    }
 };
+
+template <class T> void CommandBuffer::addComponent(Handle entity, const T &value)
+{
+    auto command = record(entity, sizeof(T), alignof(T));
+    new (command->payload) T(value);
+    command->apply = [](Registry &registry, Handle entity, void *payload) {
+        registry.addComponent(entity, *(T *)payload);
+    };
+    command->destroy = [](void *payload) { ((T *)payload)->~T(); };
+}
+
+template <class T> void CommandBuffer::removeComponent(Handle entity)
+{
+    record(entity)->apply = [](Registry &registry, Handle entity, void *) { registry.removeComponent<T>(entity); };
+}
+
+template <typename... Ts> View<Ts...> &Registry::view()
+{
+    std::lock_guard<std::mutex> lock(viewMutex);
+    auto &view = views[typeid(View<Ts...>)];
+    if (!view)
+    {
+        view = new View<Ts...>(this);
+        for (int id : {ComponentType::of<Ts>().id...})
+        {
+            if (id >= int(componentViews.size()))
+                componentViews.resize(size_t(id) + 1);
+            componentViews[id].push_back(view);
+        }
+    }
+    return *static_cast<View<Ts...> *>(view);
+}
 #endif // Registry_h__
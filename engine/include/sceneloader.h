@@ -0,0 +1,81 @@
+#ifndef sceneloader_h__
+#define sceneloader_h__
+
+#include "registry.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Loads a json scene written by Registry::toJson through the sax interface of nlohmann json. Only the component
+// being parsed is held as json, every finished component goes straight into its storage. Either load() reads the
+// whole file at once, or step() is called once per frame: the file is then parsed on a thread of its own that
+// waits whenever QUEUE_LIMIT parsed components are waiting to be applied on the main thread.
+class SceneLoader
+{
+  public:
+    static const size_t QUEUE_LIMIT = 1024;
+
+    SceneLoader(Registry *registry, const std::string &path);
+    ~SceneLoader();
+
+    // Parses and applies the whole file on the calling thread, false if it could not be read or parsed.
+    bool load();
+
+    // Applies parsed components until budget runs out, starting the parse thread on the first call. Returns true
+    // once the whole file is applied or loading failed. Without job system workers the file is loaded at once.
+    bool step(std::chrono::microseconds budget);
+
+    bool failed() const
+    {
+        return !error.empty();
+    }
+
+    const std::string &errorMessage() const
+    {
+        return error;
+    }
+
+    // Entities applied to the registry so far.
+    size_t loaded() const
+    {
+        return entityCount;
+    }
+
+    // One parsed piece of the scene, an entity is claimed before its components and its views are updated after.
+    struct Row
+    {
+        enum Kind
+        {
+            Begin,
+            Component,
+            End
+        } kind;
+        Handle entity;
+        std::string type;
+        json value;
+    };
+
+  private:
+    Registry *registry;
+    std::string path;
+    std::string error;
+    size_t entityCount = 0;
+
+    std::thread parser;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Row> queue;
+    bool started = false;
+    bool parsed = false;
+    bool cancelled = false;
+
+    // Runs the sax parser over the file, handing every row to emit until it returns false.
+    template <typename F> bool parse(F &&emit);
+    void apply(Row &row);
+};
+
+#endif // sceneloader_h__
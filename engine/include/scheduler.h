@@ -0,0 +1,41 @@
+#ifndef scheduler_h__
+#define scheduler_h__
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class System;
+class JobSystem;
+
+// Runs the systems of one frame as a dependency graph. A system waits for every earlier system it conflicts with,
+// systems that don't conflict run at the same time on the job system workers.
+class Scheduler
+{
+  public:
+    void build(const std::vector<System *> &systems);
+    void run();
+
+  private:
+    struct Node
+    {
+        System *system;
+        int dependencies = 0;
+        std::vector<int> dependents;
+    };
+
+    std::vector<Node> nodes;
+    std::unique_ptr<std::atomic<int>[]> remaining;
+    std::atomic<int> pending{0};
+    std::mutex mainMutex;
+    std::vector<int> mainReady;
+    JobSystem *jobs = nullptr;
+    bool warm = false;
+
+    static bool conflicts(const System &a, const System &b);
+    void schedule(int node);
+    void finish(int node);
+};
+
+#endif // scheduler_h__
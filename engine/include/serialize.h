@@ -1,9 +1,23 @@
 #ifndef serialize_h__
 #define serialize_h__
 
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+// The glm configuration of types.h, for when this header is included before it.
+#ifndef GLM_FORCE_CTOR_INIT
+#define GLM_FORCE_CTOR_INIT
+#endif
+#ifndef GLM_FORCE_SWIZZLE
+#define GLM_FORCE_SWIZZLE
+#endif
+#include <glm/glm.hpp>
 #include <json.hpp>
 
 using json = nlohmann::json;
@@ -43,155 +57,366 @@ inline void from_json(const json &j, glm::vec4 &p)
     p.z = j.at(2).get<float>();
     p.w = j.at(3).get<float>();
 }
+inline void to_json(json &j, const glm::quat &q)
+{
+    j = {q.x, q.y, q.z, q.w};
+};
+
+inline void from_json(const json &j, glm::quat &q)
+{
+    q.x = j.at(0).get<float>();
+    q.y = j.at(1).get<float>();
+    q.z = j.at(2).get<float>();
+    q.w = j.at(3).get<float>();
+}
 } // namespace glm
 
-struct SerializerBase
+// Appends raw bytes to out, used by the binary scene format.
+struct BinaryWriter
 {
-    std::string name;
+    std::vector<uint8_t> &out;
 
-    SerializerBase(std::string name) : name(name)
+    void bytes(const void *data, size_t size)
     {
+        auto begin = (const uint8_t *)data;
+        out.insert(out.end(), begin, begin + size);
     }
 
-    virtual void serialize(void *obj, json &j)
+    template <typename T> void value(const T &v)
     {
+        bytes(&v, sizeof(T));
     }
-    virtual void unserialize(void *obj, const json &j)
+
+    void string(const std::string &s)
     {
+        value(uint32_t(s.size()));
+        bytes(s.data(), s.size());
     }
 };
 
-struct Encoder
+// Reads back what BinaryWriter wrote, throws when the data ends early.
+struct BinaryReader
 {
-    std::vector<SerializerBase *> serializers;
-    Encoder(std::vector<SerializerBase *> serializers) : serializers(serializers)
+    const uint8_t *cursor;
+    const uint8_t *end;
+
+    const uint8_t *bytes(size_t size)
     {
+        if (size_t(end - cursor) < size)
+            throw std::runtime_error("Binary data is truncated");
+        auto begin = cursor;
+        cursor += size;
+        return begin;
     }
 
-    void serialize(void *obj, json &j)
+    template <typename T> T value()
     {
-        for (auto &s : serializers)
-        {
-            s->serialize(obj, j[s->name]);
-        }
+        T v;
+        memcpy(&v, bytes(sizeof(T)), sizeof(T));
+        return v;
     }
-    void unserialize(void *obj, const json &j)
+
+    // Reads a count stored as T of items taking at least itemSize bytes each. Counts the rest of the data can't
+    // hold are rejected before anyone allocates for them or multiplies them.
+    template <typename T> size_t count(size_t itemSize)
     {
-        for (auto &s : serializers)
-        {
-            s->unserialize(obj, j[s->name]);
-        }
+        auto n = uint64_t(value<T>());
+        if (n > uint64_t(end - cursor) / itemSize)
+            throw std::runtime_error("Binary data is truncated");
+        return size_t(n);
     }
-};
 
-template <typename T, typename Enable = void> struct SerializerFor
-{
-    void serializeValue(T &value, json &j)
+    std::string string()
     {
-        j = json(value);
+        auto size = value<uint32_t>();
+        auto begin = bytes(size);
+        return std::string((const char *)begin, size);
     }
-    void unserializeValue(T &value, const json &j)
+};
+
+// Describes one serialized member of C. Components list theirs in a constexpr serializer() function returning
+// serialize("name", &C::member, ...), which is evaluated once at compile time into FieldsOf<C>::value.
+template <typename C, typename T> struct Field
+{
+    using Type = T;
+
+    const char *name;
+    T C::*member;
+};
+
+template <typename... Fs> struct Fields
+{
+    std::tuple<Fs...> fields;
+
+    template <typename F> constexpr void each(F &&fn) const
     {
-        value = j.get<T>();
+        std::apply([&](const Fs &... field) { (fn(field), ...); }, fields);
     }
 };
 
+constexpr std::tuple<> fieldTuple()
+{
+    return {};
+}
+
+template <typename C, typename T, typename... Args>
+constexpr auto fieldTuple(const char *name, T C::*member, Args... args)
+{
+    return std::tuple_cat(std::make_tuple(Field<C, T>{name, member}), fieldTuple(args...));
+}
+
+template <typename... Args> constexpr auto serialize(Args... args)
+{
+    return std::apply([](auto... field) { return Fields<decltype(field)...>{{field...}}; }, fieldTuple(args...));
+}
+
+template <typename T> struct isFields : std::false_type
+{
+};
+template <typename... Fs> struct isFields<Fields<Fs...>> : std::true_type
+{
+};
+
+template <typename T, typename = void> struct isSerializable : std::false_type
+{
+};
+template <typename T> struct isSerializable<T, std::void_t<decltype(T::serializer())>> : isFields<decltype(T::serializer())>
+{
+};
+
+template <typename T> struct FieldsOf
+{
+    static constexpr auto value = T::serializer();
+};
+
+template <typename T> struct isVector : std::false_type
+{
+};
+template <typename T, typename A> struct isVector<std::vector<T, A>> : std::true_type
+{
+};
+
+template <typename T, typename = void> struct isMap : std::false_type
+{
+};
 template <typename T>
-struct SerializerFor<T, std::enable_if_t<std::is_void<decltype(std::declval<T>().emplace_back(T::value_type))>::value>>
+struct isMap<T, std::void_t<typename T::key_type, typename T::mapped_type>> : std::true_type
 {
-    void serializeValue(T &value, json &j)
+};
+
+// Values that are written to binary data as they are in memory.
+template <typename T>
+constexpr bool isPod = std::is_trivially_copyable<T>::value && !isSerializable<T>::value;
+
+template <typename T> void writeJson(const T &value, json &j)
+{
+    if constexpr (isSerializable<T>::value)
     {
-        auto sf = SerializerFor<typename T::value_type>();
-        for (auto &v : value)
+        FieldsOf<T>::value.each([&](const auto &field) { writeJson(value.*field.member, j[field.name]); });
+    }
+    else if constexpr (isVector<T>::value)
+    {
+        j = json::array();
+        for (auto &&v : value)
         {
             json jv;
-            sf.serializeValue(v, jv);
+            writeJson<typename T::value_type>(v, jv);
             j.push_back(jv);
         }
     }
-    void unserializeValue(T &value, const json &j)
+    else if constexpr (isMap<T>::value)
     {
-        auto sf = SerializerFor<typename T::value_type>();
-        for (auto jv : j)
-        {
-            typename T::value_type v;
-            sf.unserializeValue(v, jv);
-            value.push_back(v);
-        }
+        j = json::object();
+        for (auto &kv : value)
+            writeJson(kv.second, j[kv.first]);
     }
-};
+    else
+    {
+        j = json(value);
+    }
+}
 
-template <typename T>
-struct SerializerFor<T, std::enable_if_t<std::is_integral<decltype(std::declval<T>().count(T::key_type()))>::value>>
+// Fields missing from j keep their value, so a partial object written by diffJson can be applied on top.
+template <typename T> void readJson(T &value, const json &j)
 {
-    void serializeValue(T &value, json &j)
+    if constexpr (isSerializable<T>::value)
     {
-        for (auto kv : value)
-        {
-            SerializerFor<typename T::mapped_type>().serializeValue(kv.second, j[kv.first]);
-        }
+        FieldsOf<T>::value.each([&](const auto &field) {
+            auto it = j.find(field.name);
+            if (it != j.end())
+                readJson(value.*field.member, *it);
+        });
     }
-    void unserializeValue(T &value, const json &j)
+    else if constexpr (isVector<T>::value)
     {
-        for (auto kv : json::iterator_wrapper(j))
+        value.clear();
+        for (auto &jv : j)
         {
-            SerializerFor<typename T::mapped_type>().unserializeValue(value[kv.key()], kv.value());
+            typename T::value_type v;
+            readJson(v, jv);
+            value.push_back(v);
         }
     }
-};
+    else if constexpr (isMap<T>::value)
+    {
+        for (auto &kv : j.items())
+            readJson(value[kv.key()], kv.value());
+    }
+    else
+    {
+        value = j.get<T>();
+    }
+}
 
-template <typename T>
-struct SerializerFor<T, std::enable_if_t<std::is_same<decltype(std::declval<T>().serializer()), Encoder>::value>>
+template <typename T> bool equalValues(const T &a, const T &b)
 {
-    void serializeValue(T &value, json &j)
+    if constexpr (isSerializable<T>::value)
     {
-        T::serializer().serialize(&value, j);
+        bool equal = true;
+        FieldsOf<T>::value.each(
+            [&](const auto &field) { equal = equal && equalValues(a.*field.member, b.*field.member); });
+        return equal;
     }
-    void unserializeValue(T &value, const json &j)
+    else
     {
-        T::serializer().unserialize(&value, j);
+        return a == b;
     }
-};
+}
 
-template <typename C, typename T> struct Serializer : SerializerBase, SerializerFor<T>
+// The fields of after that differ from before, readJson of the result into before yields after.
+template <typename T> void diffJson(const T &before, const T &after, json &j)
 {
-    T C::*member;
+    j = json::object();
+    FieldsOf<T>::value.each([&](const auto &field) {
+        if (!equalValues(before.*field.member, after.*field.member))
+            writeJson(after.*field.member, j[field.name]);
+    });
+}
 
-    Serializer(const char *name, T C::*member) : SerializerBase(name), member(member)
+// Binary encoding of a value. Values that can be copied as bytes are, vectors of them in one block, and anything
+// else goes through its json conversion as CBOR.
+template <typename T> void writeBinary(const T &value, BinaryWriter &w)
+{
+    if constexpr (isSerializable<T>::value)
+    {
+        FieldsOf<T>::value.each([&](const auto &field) { writeBinary(value.*field.member, w); });
+    }
+    else if constexpr (std::is_same<T, std::string>::value)
     {
+        w.string(value);
     }
+    else if constexpr (std::is_trivially_copyable<T>::value)
+    {
+        w.value(value);
+    }
+    else if constexpr (isVector<T>::value)
+    {
+        using V = typename T::value_type;
+        w.value(uint32_t(value.size()));
+        if constexpr (isPod<V> && !std::is_same<V, bool>::value)
+        {
+            w.bytes(value.data(), value.size() * sizeof(V));
+        }
+        else
+        {
+            for (auto &&v : value)
+                writeBinary<V>(v, w);
+        }
+    }
+    else
+    {
+        json j;
+        writeJson(value, j);
+        auto bytes = json::to_cbor(j);
+        w.value(uint32_t(bytes.size()));
+        w.bytes(bytes.data(), bytes.size());
+    }
+}
 
-    virtual void serialize(void *obj, json &j)
+template <typename T> void readBinary(T &value, BinaryReader &r)
+{
+    if constexpr (isSerializable<T>::value)
     {
-        this->serializeValue((((C *)(obj))->*member), j);
+        FieldsOf<T>::value.each([&](const auto &field) { readBinary(value.*field.member, r); });
     }
-    virtual void unserialize(void *obj, const json &j)
+    else if constexpr (std::is_same<T, std::string>::value)
     {
-        this->unserializeValue((((C *)(obj))->*member), j);
+        value = r.string();
+    }
+    else if constexpr (std::is_trivially_copyable<T>::value)
+    {
+        memcpy(&value, r.bytes(sizeof(T)), sizeof(T));
+    }
+    else if constexpr (isVector<T>::value)
+    {
+        using V = typename T::value_type;
+        auto count = r.value<uint32_t>();
+        if constexpr (isPod<V> && !std::is_same<V, bool>::value)
+        {
+            auto bytes = r.bytes(count * sizeof(V));
+            value.resize(count);
+            memcpy(value.data(), bytes, count * sizeof(V));
+        }
+        else
+        {
+            value.clear();
+            for (uint32_t i = 0; i < count; i++)
+            {
+                V v;
+                readBinary(v, r);
+                value.push_back(v);
+            }
+        }
     }
+    else
+    {
+        auto size = r.value<uint32_t>();
+        auto begin = r.bytes(size);
+        readJson(value, json::from_cbor(begin, begin + size));
+    }
+}
+
+// Type-erased view of one field, for code that only knows the component type at runtime.
+struct FieldInfo
+{
+    const char *name;
+    // Byte size of fields stored as they are in memory, 0 when the size varies.
+    size_t podSize;
+    void *(*address)(void *obj);
+    void (*write)(const void *obj, BinaryWriter &w);
+    void (*read)(void *obj, BinaryReader &r);
 };
 
-template <typename T, typename... Args> Encoder serialize(const char *name, T field, Args... args)
+template <typename C, size_t I> FieldInfo fieldInfo()
 {
-    Encoder encoder({new Serializer(name, field)});
-    const auto &enc = serialize(args...);
-    encoder.serializers.insert(encoder.serializers.end(), enc.serializers.begin(), enc.serializers.end());
-    return encoder;
+    using T = typename std::tuple_element_t<I, decltype(FieldsOf<C>::value.fields)>::Type;
+    return {
+        std::get<I>(FieldsOf<C>::value.fields).name,
+        isPod<T> ? sizeof(T) : 0,
+        [](void *obj) -> void * { return &(((C *)obj)->*std::get<I>(FieldsOf<C>::value.fields).member); },
+        [](const void *obj, BinaryWriter &w) {
+            writeBinary(((const C *)obj)->*std::get<I>(FieldsOf<C>::value.fields).member, w);
+        },
+        [](void *obj, BinaryReader &r) { readBinary(((C *)obj)->*std::get<I>(FieldsOf<C>::value.fields).member, r); },
+    };
 }
 
-template <typename T> Encoder serialize(const char *name, T field)
+template <typename C, size_t... I> std::vector<FieldInfo> fieldInfos(std::index_sequence<I...>)
 {
-    Encoder encoder({new Serializer(name, field)});
-    return encoder;
+    return {fieldInfo<C, I>()...};
 }
 
-template <typename T, typename = void> struct isSerializable : std::false_type
+template <typename C> std::vector<FieldInfo> fieldInfos()
 {
-};
-template <typename T>
-struct isSerializable<T, std::enable_if_t<std::is_same<decltype(std::declval<T>().serializer()), Encoder>::value>>
-    : std::true_type
-{
-};
+    if constexpr (isSerializable<C>::value)
+    {
+        constexpr auto count = std::tuple_size<decltype(FieldsOf<C>::value.fields)>::value;
+        return fieldInfos<C>(std::make_index_sequence<count>());
+    }
+    else
+    {
+        return {};
+    }
+}
 
 #endif // serialize_h__
\ No newline at end of file
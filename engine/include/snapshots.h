@@ -0,0 +1,116 @@
+#ifndef snapshots_h__
+#define snapshots_h__
+
+#include "registry.h"
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Records the changes of a registry as compact binary deltas, for undo and redo, restoring an earlier state and
+// saving only what changed. Every component and entity the registry reports as changing keeps its old value in the
+// dirty set of its type until the next commit(), which encodes the new values of just those and drops whatever
+// ended up unchanged. Components are encoded with the fields of their serializer(), types without one are not
+// recorded. Values written through references must be reported with Registry::touch() first.
+class Snapshots : public ChangeListener
+{
+  public:
+    // Bytes of deltas kept for undo, the oldest are dropped beyond that.
+    static const size_t DEFAULT_BUDGET = 64 << 20;
+
+    Snapshots(Registry *registry, size_t budget = DEFAULT_BUDGET);
+    ~Snapshots();
+
+    // Turns the changes reported since the last commit into one undo step, false if nothing changed.
+    bool commit();
+
+    // Commit pending changes, then step back or forward through the deltas.
+    bool undo();
+    bool redo();
+
+    bool canUndo() const
+    {
+        return cursor > 0;
+    }
+
+    bool canRedo() const
+    {
+        return cursor < ring.size();
+    }
+
+    // Steps taken since recording started, restore() goes back or forward to one still on the ring.
+    size_t position() const
+    {
+        return dropped + cursor;
+    }
+    bool restore(size_t position);
+
+    // Changes reported while not recording are left out of the history and the journal, so an owner recording
+    // around its own edits does not get steps for what systems change on their own, like assets that finish loading.
+    void record(bool on)
+    {
+        recording = on;
+    }
+
+    // Forgets the pending changes and all deltas, the current state becomes the start of the history.
+    void clear();
+
+    size_t memoryUsed() const
+    {
+        return ringBytes;
+    }
+
+    // Appends the values of what changed since the last call to the journal at path, the first call writes
+    // everything changed since recording started. Entities include rejects are left out. The journal is read back
+    // by loadIncremental() on top of the scene it started from, as long as the component layout did not change.
+    // Truncated journals and component images that no longer decode throw std::runtime_error before anything is
+    // applied.
+    bool saveIncremental(const std::string &path, const std::function<bool(Handle)> &include = nullptr);
+    static bool loadIncremental(Registry *registry, const std::string &path);
+
+    // The scene was saved in full, the next journal starts from here.
+    void saved()
+    {
+        unsaved.clear();
+        unsavedEntities.clear();
+    }
+
+    void componentChanging(Handle entity, const ComponentType &type) override;
+    void entityChanging(Handle entity, bool alive) override;
+
+  private:
+    struct Image
+    {
+        bool present = false;
+        std::vector<uint8_t> bytes;
+    };
+
+    Registry *registry;
+    size_t budget;
+    bool applying = false;
+    bool recording = true;
+
+    // Old values by component type id and entity, old liveness by entity.
+    std::vector<std::unordered_map<Handle, Image>> dirty;
+    std::unordered_map<Handle, bool> dirtyEntities;
+
+    std::deque<std::vector<uint8_t>> ring;
+    size_t cursor = 0;
+    size_t dropped = 0;
+    size_t ringBytes = 0;
+
+    // Changed since the last saveIncremental().
+    std::vector<std::unordered_set<Handle>> unsaved;
+    std::unordered_set<Handle> unsavedEntities;
+
+    Image capture(Handle entity, const ComponentType &type);
+    void push(std::vector<uint8_t> &&delta);
+    // Sets every entity and component of delta to its value before or after it.
+    void apply(const std::vector<uint8_t> &delta, bool after);
+    void markUnsaved(Handle entity, int typeId);
+};
+
+#endif // snapshots_h__
@@ -3,20 +3,30 @@
 
 #include "types.h"
 
+#include <atomic>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <functional>
 
 #include "serialize.h"
+#include "component.h"
 
 class StorageBase
 {
   private:
     static std::map<std::string, std::function<StorageBase *()>> *_constructors;
   public:
+    virtual ~StorageBase()
+    {
+    }
+
     virtual void copy(Handle source, Handle target) = 0;
     virtual std::vector<Handle> entities() = 0;
     virtual std::string description() = 0;
-    virtual void remove(int entityId) = 0;
+    virtual void remove(Handle entityId) = 0;
+    virtual void remove(const std::vector<Handle> &entities) = 0;
     virtual StorageBase *clone()=0;
 
     
@@ -30,24 +40,146 @@ class StorageBase
     virtual void serialize(Handle entity, json& j) = 0;
     virtual void unserialize(Handle entity, json &j) = 0;
     virtual std::string componentTypeName()=0;
-    virtual void add(int entityId, void *v) = 0;    
+    virtual void add(Handle entityId, void *v) = 0;    
+    // Type-erased access for serialization, getRaw is for reading and emplaceRaw default constructs a missing
+    // component.
+    virtual const void *getRaw(Handle entityId) = 0;
+    virtual void *emplaceRaw(Handle entityId) = 0;
+    // Frees the pages replaced by copies, only once no system is running.
+    virtual void releaseRetired() = 0;
 };
 
+// Components per storage page, pages are what clones share until written. Divides PAR_EACH_GRAIN, so the jobs of
+// par_each over a storage never write into the same page.
+const size_t STORAGE_PAGE_SIZE = 256;
+
 
 template<class C>
 class Storage :public StorageBase
 {
 private:
-    std::map<int, C> componentMap;
+    typedef std::vector<C> Page;
+
+    // Sparse set: components and their owners are packed in dense arrays, sparse maps entity index -> dense index.
+    // Components are split in pages of STORAGE_PAGE_SIZE that clone() shares instead of copying. Writable access
+    // copies a page first while the shared flag says a clone may still use it, read() and forEachRead() never do.
+    // Writable access needs a system declaring writes<C>, which the scheduler never runs alongside readers of C, but
+    // par_each chunks copy their own pages while callbacks of other chunks read them, so components are reached
+    // through current, which a copy replaces atomically. The page it replaced is retired instead of released, so
+    // readers that still hold it stay valid and the clone never writes into it in place, until Registry::cleanUp()
+    // releases it after the systems of the frame have joined.
+    std::vector<std::shared_ptr<Page>> pages;
+    std::deque<std::atomic<Page *>> current;
+    std::deque<std::atomic<bool>> shared;
+    std::vector<std::shared_ptr<Page>> retired;
+    std::mutex detachMutex;
+    std::vector<Handle> dense;
+    std::vector<int> sparse;
+
+    static constexpr int npos = -1;
+
+    C &at(size_t index)
+    {
+        auto page = index / STORAGE_PAGE_SIZE;
+        if (shared[page].load(std::memory_order_acquire))
+            detach(page);
+        return (*current[page].load(std::memory_order_relaxed))[index % STORAGE_PAGE_SIZE];
+    }
+
+    const C &peek(size_t index) const
+    {
+        return (*current[index / STORAGE_PAGE_SIZE].load(std::memory_order_acquire))[index % STORAGE_PAGE_SIZE];
+    }
+
+    void detach(size_t page)
+    {
+        // par_each chunks detach their pages from several threads at once.
+        std::lock_guard<std::mutex> lock(detachMutex);
+        if (!shared[page].load(std::memory_order_relaxed))
+            return;
+        if (pages[page].use_count() > 1)
+        {
+            // Reserved like every page, so pushBack never moves the components of a detached last page.
+            auto copy = std::make_shared<Page>();
+            copy->reserve(STORAGE_PAGE_SIZE);
+            copy->insert(copy->end(), pages[page]->begin(), pages[page]->end());
+            retired.push_back(std::move(pages[page]));
+            pages[page] = std::move(copy);
+            current[page].store(pages[page].get(), std::memory_order_release);
+        }
+        shared[page].store(false, std::memory_order_release);
+    }
+
+    void pushBack(C &&value)
+    {
+        if (dense.size() % STORAGE_PAGE_SIZE == 0)
+        {
+            pages.push_back(std::make_shared<Page>());
+            pages.back()->reserve(STORAGE_PAGE_SIZE);
+            current.emplace_back(pages.back().get());
+            shared.emplace_back(false);
+        }
+        else if (shared.back())
+        {
+            detach(pages.size() - 1);
+        }
+        pages.back()->push_back(std::move(value));
+    }
+
+    void popBack()
+    {
+        if (shared.back())
+            detach(pages.size() - 1);
+        pages.back()->pop_back();
+        if (pages.back()->empty())
+        {
+            pages.pop_back();
+            current.pop_back();
+            shared.pop_back();
+        }
+    }
+
+    int indexOf(Handle entityId) const
+    {
+        auto slot = handleIndex(entityId);
+        if (slot >= sparse.size() || sparse[slot] == npos || dense[sparse[slot]] != entityId)
+            return npos;
+        return sparse[slot];
+    }
+
+    C &emplace(Handle entityId)
+    {
+        auto slot = handleIndex(entityId);
+        if (slot < sparse.size() && sparse[slot] != npos)
+        {
+            auto index = sparse[slot];
+            if (dense[index] != entityId)
+            {
+                // Left behind by a previous generation of this index.
+                dense[index] = entityId;
+                at(index) = C();
+            }
+            return at(index);
+        }
+        if (slot >= sparse.size())
+        {
+            sparse.resize(size_t(slot) + 1, npos);
+        }
+        sparse[slot] = (int)dense.size();
+        pushBack(C());
+        dense.push_back(entityId);
+        return at(dense.size() - 1);
+    }
+
 public:
-    void add(int entityId, C& v)
+    void add(Handle entityId, C& v)
     {
-        componentMap[entityId] = v;
+        emplace(entityId) = v;
     };
 
-    virtual void add(int entityId, void *v)
+    virtual void add(Handle entityId, void *v)
     {
-        componentMap[entityId] = *((C*)(v));
+        emplace(entityId) = *((C*)(v));
     }
 
     virtual bool isSerializable() override
@@ -63,7 +195,7 @@ public:
     {
         if constexpr (::isSerializable<C>())
         {
-            C::serializer().serialize(&componentMap[entity], j);
+            writeJson(*read(entity), j);
         }
     }
 
@@ -71,7 +203,7 @@ public:
     {
         if constexpr (::isSerializable<C>())
         {
-            C::serializer().unserialize(&componentMap[entity], j);
+            readJson(emplace(entity), j);
         }
     }
 
@@ -80,51 +212,128 @@ public:
         return typeid(C).name();
     }
 
+    // Shares every page with the copy, both sides copy a page before they first write to it.
     StorageBase* clone()
     {
         auto cpy = new Storage<C>();
-        cpy->componentMap = componentMap;
+        cpy->pages = pages;
+        for (auto &page : pages)
+            cpy->current.emplace_back(page.get());
+        for (auto &flag : shared)
+        {
+            flag = true;
+            cpy->shared.emplace_back(true);
+        }
+        cpy->dense = dense;
+        cpy->sparse = sparse;
         return cpy;
     }
 
+    void releaseRetired() override
+    {
+        retired.clear();
+    }
+
     virtual void copy(Handle source, Handle target) override
     {
-        if (componentMap.count(source))
-            componentMap[target] = componentMap[source];
+        auto index = indexOf(source);
+        if (index != npos)
+        {
+            C value = peek(index);
+            emplace(target) = value;
+        }
     }
 
-    virtual void remove(int entityId) override
+    virtual void remove(Handle entityId) override
     {
-        if (componentMap.count(entityId))
-            componentMap.erase(entityId);
+        auto index = indexOf(entityId);
+        if (index == npos)
+            return;
+        auto last = (int)dense.size() - 1;
+        if (index != last)
+        {
+            // Last first, when both are in one shared page the copy is made before index is looked up.
+            auto &moved = at(last);
+            at(index) = std::move(moved);
+            dense[index] = dense[last];
+            sparse[handleIndex(dense[index])] = index;
+        }
+        popBack();
+        dense.pop_back();
+        sparse[handleIndex(entityId)] = npos;
     }
 
-    C* get(int entityId)
+    virtual void remove(const std::vector<Handle> &entities) override
     {
-        return componentMap.count(entityId) > 0 ? &componentMap[entityId] : nullptr;
+        if (dense.empty())
+            return;
+        for (auto entity : entities)
+        {
+            Storage::remove(entity);
+        }
+    }
+
+    C* get(Handle entityId)
+    {
+        auto index = indexOf(entityId);
+        return index != npos ? &at(index) : nullptr;
     };
 
+    const C *read(Handle entityId) const
+    {
+        auto index = indexOf(entityId);
+        return index != npos ? &peek(index) : nullptr;
+    }
+
     virtual bool has(Handle entity)
     {
-        return componentMap.count(entity);
+        return indexOf(entity) != npos;
     }
 
-    void forEach(std::function<void(int entityId, C& value)> fn)
+    virtual const void *getRaw(Handle entityId) override
     {
-        for (auto& v : componentMap)
+        return read(entityId);
+    }
+
+    virtual void *emplaceRaw(Handle entityId) override
+    {
+        return &emplace(entityId);
+    }
+
+    size_t size() const
+    {
+        return dense.size();
+    }
+
+    template <typename F> void forEach(F &&fn)
+    {
+        // Callbacks must not add or remove C: an add may invalidate the reference they were handed, and a remove
+        // moves the last component into the freed slot, which the walk then skips.
+        for (size_t i = 0; i < dense.size(); i++)
         {
-            fn(v.first, v.second);
+            fn(dense[i], at(i));
         }
     };
 
-    virtual std::vector<Handle> entities() override
+    template <typename F> void forEachRead(F &&fn) const
     {
-        auto ret = std::vector<Handle>();
-        for (auto v : componentMap)
+        for (size_t i = 0; i < dense.size(); i++)
         {
-            ret.push_back(v.first);
+            fn(dense[i], peek(i));
         }
-        return ret;
+    }
+
+    template <typename F> void forEach(size_t begin, size_t end, F &&fn)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            fn(dense[i], at(i));
+        }
+    }
+
+    virtual std::vector<Handle> entities() override
+    {
+        return dense;
     }
      
     virtual std::string description()  override
@@ -136,6 +345,7 @@ public:
 template <class T> bool StorageBase::registerComponent()
 {
     (*constructors())[typeid(T).name()] = []() { return new Storage<T>(); };
+    ComponentType::of<T>();
     return true;
 }
 
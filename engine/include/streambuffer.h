@@ -0,0 +1,40 @@
+#ifndef streambuffer_h__
+#define streambuffer_h__
+
+#include <gl/glew.h>
+
+#include <cstddef>
+
+// GL buffer for data rewritten every frame, split into STREAM_REGIONS regions used round robin. A write waits on
+// the fence of the frames that last read its region instead of stalling on the whole buffer, and the storage is
+// only reallocated when a write outgrows a region. Persistently mapped when the driver supports buffer storage.
+struct StreamBuffer
+{
+    static const int STREAM_REGIONS = 3;
+
+    GLuint buffer = 0;
+    size_t regionSize = 0;
+
+    // Binds the buffer to target, copies size bytes into the next region and returns its offset in the buffer.
+    size_t write(GLenum target, const void *data, size_t size);
+
+    // Moves to the next region without writing, for a frame filled by append().
+    void nextRegion();
+
+    // Binds the buffer to target and copies size bytes after the data already in the current region. A full region
+    // restarts in a larger buffer, draws issued earlier keep reading the old one but its bindings are reset.
+    size_t append(GLenum target, const void *data, size_t size);
+
+    void destroy();
+
+  private:
+    int region = 0;
+    size_t used = 0;
+    GLsync fences[STREAM_REGIONS] = {};
+    void *mapped = nullptr;
+
+    void reserve(GLenum target, size_t size);
+    void copy(GLenum target, size_t offset, const void *data, size_t size);
+};
+
+#endif // streambuffer_h__
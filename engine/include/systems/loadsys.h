@@ -2,6 +2,13 @@
 #define loadsys_h__
 
 #include "systems/system.h"
+#include "assetcache.h"
+
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+
+struct GLTFImport;
 
 class LoadSys : public System
 {
@@ -13,7 +20,33 @@ class LoadSys : public System
 
     void process() override;
 
+    const AssetCache &assetCache() const
+    {
+        return assets;
+    }
+
   private:
-    Handle loadGLTF(std::string path);
+    // Imports by path. Parsing, image decoding and vertex conversion run as jobs, the entities are created by
+    // finalize() on the main thread within the frame budget.
+    std::unordered_map<std::string, std::unique_ptr<GLTFImport>> imports;
+
+    // Refs instantiated from a cached proto with the children instantiate() created for them. The children use the
+    // meshes, geometries and materials of the proto, so once the Ref or its entity is gone they are destroyed
+    // before the reference is dropped.
+    struct Holder
+    {
+        Handle entity;
+        Handle proto;
+        std::vector<Handle> children;
+    };
+    AssetCache assets;
+    std::vector<Holder> holders;
+
+    void releaseHolders();
+
+    std::unique_ptr<GLTFImport> startImport(const std::string &path);
+
+    // Creates entities of a finished import until deadline, returns its proto root once all of them exist.
+    Handle finalize(GLTFImport &import, std::chrono::steady_clock::time_point deadline);
 };
 #endif // loadsys_h__
\ No newline at end of file
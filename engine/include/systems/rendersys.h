@@ -4,12 +4,26 @@
 #include "System.h"
 #include "Types.h"
 #include "components/render.h"
+#include "boundsbatch.h"
+#include "drawlist.h"
+#include "debugdraw.h"
+#include "streambuffer.h"
+
+// GL work issued by RenderSys during the last frame.
+struct RenderStats
+{
+    unsigned draws = 0;
+    unsigned binds = 0;
+    unsigned uniforms = 0;
+};
 
 class RenderSys : public System
 {
   private:
     static RenderSys *_instance;
-    void bindMaterial(const Geometry &geo, const GLPipeline &pipeline);
+    void bindMaterial(const Geometry &geo, const short *uniforms);
+
+    void bindVertexArray(GLuint vao);
 
 	void drawGeometry(const GLPipeline &pipeline, const GLGeometry &ggeo);
 
@@ -18,6 +32,70 @@ class RenderSys : public System
 
 	void renderPass(RenderPassInstance &pass, Camera &camera);
 
+    // Entities passing the frustum test of the camera being rendered, shared by all subpasses of a pass.
+    std::vector<Handle> visibleGeometries;
+    std::vector<Handle> visibleRenderables;
+    BoundsBatch bounds;
+    std::vector<Handle> candidates;
+    std::vector<uint8_t> visible;
+
+    void cull(Camera &camera);
+
+    // Sorted draws of the subpass being rendered and the state they left bound, so consecutive draws sharing a
+    // material or vertex array skip the rebinding.
+    DrawList drawList;
+    Handle boundMaterial;
+    GLuint boundVao;
+    RenderStats stats;
+
+    void resetState();
+
+    // Uniform blocks, see UniformBlockBinding. Camera blocks and the DrawBlocks of every subpass are appended to
+    // their streams through the frame, the pass block is uploaded once in start(). DrawBlocks are drawStride bytes
+    // apart in drawData, one per item of singles, then one per instance run and one for the debug lines.
+    StreamBuffer cameraStream;
+    StreamBuffer drawStream;
+    GLuint passBuffer = 0;
+    std::vector<uint8_t> drawData;
+    size_t drawStride = 0;
+    size_t drawOffset = 0;
+    // Items of the draw list drawn one by one.
+    std::vector<size_t> singles;
+    Handle drawMaterial;
+    vec4 drawColor;
+
+    void pushDraw(const mat4 &model, Handle material);
+    void bindDraw(size_t index);
+
+    // Runs of sorted draws sharing one geometry, drawn with the instanced variant of the pipeline. Their model
+    // matrices are packed into instances starting at offset and uploaded to instanceBuffer once per subpass.
+    struct InstanceRun
+    {
+        size_t begin, end, offset;
+    };
+    std::vector<InstanceRun> runs;
+    std::vector<mat4> instances;
+    GLuint instanceBuffer = 0;
+
+    void drawInstanced(const GLPipeline &pipeline, std::vector<GLAttachment> &attachments);
+
+    // DebugDraw segments of every layer, uploaded once per frame at debugOffset in debugStream. Each layer is one
+    // instanced draw of the quad in debugVao.
+    struct DebugRun
+    {
+        int mask;
+        size_t first, count;
+    };
+    std::vector<DebugDraw::Segment> debugSegments;
+    std::vector<DebugRun> debugRuns;
+    StreamBuffer debugStream;
+    size_t debugOffset = 0;
+    GLuint debugVao = 0;
+    GLuint debugQuad = 0;
+
+    void uploadDebugLines();
+    void drawDebugLines(const GLPipeline &pipeline);
+
   public:
     RenderSys();
     ~RenderSys();
@@ -25,6 +103,11 @@ class RenderSys : public System
     void start() override;
     void process() override;
 
+    const RenderStats &frameStats() const
+    {
+        return stats;
+    }
+
     static void *uiRenderTargetHandle(Handle entity);
     static RenderSys *instance();
     
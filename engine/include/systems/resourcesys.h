@@ -4,13 +4,28 @@
 #include "systems/system.h"
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include "components/render.h"
+#include "streambuffer.h"
 
 class ResourceSys: public System
 {
   private:
 	static ResourceSys* _instance;
 
+    // Buffers of the dynamic geometries this system streams, by entity. They are kept out of GLGeometry, which
+    // registry copies share, and released once their entity has no GLGeometry anymore.
+    struct GeometryStreams
+    {
+        GLuint vao = 0;
+        StreamBuffer vertices;
+        StreamBuffer indices;
+    };
+    std::unordered_map<Handle, GeometryStreams> streams;
+
+    void streamGeometry(Handle entity, Geometry &info, GLGeometry &geo);
+    void releaseStreams();
+
 public:
     GLPipeline createPipeline(Pipeline info);
     RenderPassInstance createRenderPass(RenderPass info);
@@ -0,0 +1,42 @@
+#ifndef spatialsys_h__
+#define spatialsys_h__
+
+#include "system.h"
+#include "aabbtree.h"
+
+#include <unordered_map>
+
+// Keeps world space bounding boxes of all entities with a Transform and a BBox in an AABBTree, leaves are only
+// touched when the transform or the box changed.
+class SpatialSys : public System
+{
+  private:
+    static SpatialSys *_instance;
+
+    struct Proxy
+    {
+        int leaf;
+        unsigned revision;
+        BBox box;
+        unsigned frame;
+    };
+
+    AABBTree tree;
+    std::unordered_map<Handle, Proxy> proxies;
+    unsigned frame = 0;
+
+  public:
+    SpatialSys();
+
+    void start() override;
+    void process() override;
+
+    // Nearest entity hit by ray that passes filter, 0 if none.
+    Handle raycast(const Ray &ray, float *distance = nullptr, const std::function<bool(Handle)> &filter = nullptr);
+    std::vector<Handle> overlap(const BBox &box);
+    std::vector<Handle> frustumQuery(const mat4 &viewProjection);
+
+    static SpatialSys *instance();
+};
+
+#endif // spatialsys_h__
@@ -14,30 +14,59 @@ class System
   public:
     Registry *r;
 
+    // Component types process() reads and writes, the scheduler runs systems whose sets don't conflict in
+    // parallel. A system that declares nothing is assumed to touch everything and runs alone.
+    std::vector<int> reading;
+    std::vector<int> writing;
+
+    // Systems talking to GL, ImGui or the window have to stay on the main thread. Worker systems record structural
+    // changes into a CommandBuffer and play it back from a main thread system.
+    bool mainThread = true;
+
+    template <class... C> void reads()
+    {
+        (reading.push_back(ComponentType::of<C>().id), ...);
+    }
+
+    template <class... C> void writes()
+    {
+        (writing.push_back(ComponentType::of<C>().id), ...);
+    }
+
+    bool declared() const
+    {
+        return !reading.empty() || !writing.empty();
+    }
+
     virtual void start() = 0;
     virtual void process() = 0;
 
 
+    // C is walked read only so storages shared with a registry copy stay shared, create gets the writable
+    // component, update has to ask for it when it changes C.
     template <class C, class T>
-    void syncResource(std::function<T(Handle entity, C &)> create, std::function<bool(C &)> filter = nullptr,
-                      std::function<void(C&, T&)> update = nullptr)
+    void syncResource(std::function<T(Handle entity, C &)> create, std::function<bool(const C &)> filter = nullptr,
+                      std::function<void(Handle entity, const C &, T &)> update = nullptr)
     {
-        r->each<C>([&](int entity, C &target) {
+        // Adding T while C is iterated would move rows under the archetype backend, so adds are applied afterwards.
+        CommandBuffer commands(r);
+        r->readEach<C>([&](Handle entity, const C &target) {
             if (!filter || filter(target))
             {
                 if (!r->has<T>(entity))
                 {
-                    r->addComponent(entity, create(entity, target));
+                    commands.addComponent(entity, create(entity, r->get<C>(entity)));
                 }
                 else
                 {
                     if (update)
                     {
-                        update(target, r->get<T>(entity));
+                        update(entity, target, r->get<T>(entity));
                     }
                 }
             }
         });
+        commands.playback();
     }
 };
 #endif // System_h__
@@ -2,12 +2,44 @@
 #define transformsys_h__
 
 #include "system.h"
+#include "components/transform.h"
+#include "transformbatch.h"
 
 class TransformSys : public System
 {
   public:
+    TransformSys();
+
     void start() override;
     void process() override;
+
+    // World matrix of entity composed from the current local values up its parents, for code running between two
+    // TransformSys runs that can't wait for Transform::worldMatrix() to catch up.
+    static mat4 currentWorld(Registry *r, Handle entity);
+
+  private:
+    // Flat hierarchy sorted by depth so every parent comes before its children, with the local values each world
+    // matrix was last computed from.
+    struct Node
+    {
+        Handle entity;
+        Handle parentEntity;
+        int parent;
+        vec3 position;
+        quat rotation;
+        vec3 scaling;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Transform *> transforms;
+    std::vector<bool> dirty;
+    std::vector<mat4> locals;
+    std::vector<int> changed;
+    std::vector<mat4> composed;
+    TransformBatch batch;
+
+    bool hierarchyChanged();
+    void rebuild();
 };
 
 #endif // transformsys_h__
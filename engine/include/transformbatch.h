@@ -0,0 +1,27 @@
+#ifndef transformbatch_h__
+#define transformbatch_h__
+
+#include "types.h"
+
+// Local transform values laid out as one array per scalar (SoA), converted to matrices in bulk by compose().
+// TransformSys composes the locals of everything that moved with it, the renderer reads the resulting world
+// matrices from Transform::world when it packs its draw and instance blocks.
+struct TransformBatch
+{
+    std::vector<float> px, py, pz;
+    std::vector<float> qx, qy, qz, qw;
+    std::vector<float> sx, sy, sz;
+
+    size_t size() const
+    {
+        return px.size();
+    }
+
+    void clear();
+    void push(const vec3 &position, const quat &rotation, const vec3 &scaling);
+
+    // Writes translate * rotate * scale of every entry to out, same result as Transform::matrix().
+    void compose(mat4 *out) const;
+};
+
+#endif // transformbatch_h__
@@ -11,6 +11,7 @@
 #include <glm/gtx/string_cast.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtx/vector_angle.hpp>
+#include <cstdint>
 #include <vector>
 
 #include "serialize.h"
@@ -28,7 +29,23 @@ typedef glm::quat quat;
 const float PI2 = glm::pi<float>() * 0.5f;
 const float PI = glm::pi<float>();
 
-typedef int Handle;
+// Entity handle: low 32 bits index, high 32 bits generation of that index.
+typedef uint64_t Handle;
+
+inline uint32_t handleIndex(Handle handle)
+{
+    return uint32_t(handle);
+}
+
+inline uint32_t handleGeneration(Handle handle)
+{
+    return uint32_t(handle >> 32);
+}
+
+inline Handle makeHandle(uint32_t index, uint32_t generation)
+{
+    return Handle(generation) << 32 | index;
+}
 
 struct Vertex
 {
@@ -94,7 +111,7 @@ struct BBox
     void addPoint(vec3 point);
     std::vector<vec3> vertices() const;
 
-    static Encoder serializer()
+    static constexpr auto serializer()
     {
         return serialize(
             "min", &BBox::min, 
@@ -108,5 +125,16 @@ BBox operator*(const mat4 &mat, const BBox &box);
 BBox operator+(const BBox &a, const BBox &b);
 BBox operator+=(BBox &a, const BBox &b);
 
+// The six clip planes of a view projection matrix, normals pointing inwards.
+struct Frustum
+{
+    vec4 planes[6];
+
+    Frustum(const mat4 &viewProjection);
+
+    // Conservative, boxes near a frustum corner may pass without being visible.
+    bool intersects(const BBox &box) const;
+};
+
 
-#endif // types_h__
\ No newline at end of file
+#endif // types_h__
@@ -0,0 +1,104 @@
+#ifndef view_h__
+#define view_h__
+
+#include "types.h"
+
+#include <deque>
+#include <vector>
+
+// Cached list of the entities matching a component query, kept up to date by the registry on every
+// structural change so that iterating it costs O(matches).
+class ViewBase
+{
+  protected:
+    std::vector<Handle> dense;
+    std::vector<int> sparse;
+
+    void insert(Handle entity)
+    {
+        auto slot = handleIndex(entity);
+        if (slot >= sparse.size())
+            sparse.resize(size_t(slot) + 1, -1);
+        if (sparse[slot] > -1)
+        {
+            dense[sparse[slot]] = entity;
+            return;
+        }
+        sparse[slot] = int(dense.size());
+        dense.push_back(entity);
+    }
+
+    void erase(Handle entity)
+    {
+        if (!contains(entity))
+            return;
+        auto index = sparse[handleIndex(entity)];
+        dense[index] = dense.back();
+        sparse[handleIndex(dense[index])] = index;
+        dense.pop_back();
+        sparse[handleIndex(entity)] = -1;
+    }
+
+    // Copy of dense for walks whose callbacks may change the matches. The buffers are pooled per thread and level of
+    // nested walks and keep their capacity, so walks in steady state do not allocate.
+    class WalkCopy
+    {
+        static inline thread_local std::deque<std::vector<Handle>> pool;
+        static inline thread_local size_t depth = 0;
+
+      public:
+        const std::vector<Handle> &entities;
+
+        WalkCopy(const std::vector<Handle> &dense) : entities(fill(dense))
+        {
+        }
+
+        ~WalkCopy()
+        {
+            depth--;
+        }
+
+      private:
+        static const std::vector<Handle> &fill(const std::vector<Handle> &dense)
+        {
+            auto &copy = depth < pool.size() ? pool[depth] : pool.emplace_back();
+            depth++;
+            copy.assign(dense.begin(), dense.end());
+            return copy;
+        }
+    };
+
+  public:
+    virtual ~ViewBase()
+    {
+    }
+
+    virtual bool matches(Handle entity) = 0;
+    virtual void rebuild() = 0;
+
+    bool contains(Handle entity) const
+    {
+        auto slot = handleIndex(entity);
+        return slot < sparse.size() && sparse[slot] > -1 && dense[sparse[slot]] == entity;
+    }
+
+    void update(Handle entity)
+    {
+        if (matches(entity))
+            insert(entity);
+        else
+            erase(entity);
+    }
+
+    const std::vector<Handle> &entities() const
+    {
+        return dense;
+    }
+
+    size_t size() const
+    {
+        return dense.size();
+    }
+};
+
+#endif // view_h__
@@ -3,10 +3,16 @@ precision mediump float;
 
 
 
-uniform vec4 diffuseColor;
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+layout(std140) uniform Draw
+{
+	mat4 model;
+	vec4 diffuseColor;
+};
 
 in vec4 vertexColor;
 in vec4 wPosition;
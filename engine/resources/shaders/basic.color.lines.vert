@@ -0,0 +1,52 @@
+#version 300 es
+precision mediump float;    
+
+layout(location = 0) in vec2 corner;
+layout(location = 4) in vec4 segmentStart;
+layout(location = 5) in vec3 segmentEnd;
+layout(location = 6) in vec4 segmentColor;
+
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+
+out vec4 vertexColor;
+out vec4 wPosition;
+out vec4 pPosition;
+
+// Segments are cut this far in front of the camera so both ends project with a positive w.
+const float nearZ = -0.01;
+
+void main()
+{
+//	***********vertexColor**********
+	vertexColor = segmentColor;
+
+//	***********segment**********
+	vec4 a = view * vec4(segmentStart.xyz, 1.0);
+	vec4 b = view * vec4(segmentEnd, 1.0);
+	if (a.z > nearZ && b.z > nearZ)
+	{
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+		return;
+	}
+	if (a.z > nearZ)
+		a = mix(a, b, (a.z - nearZ) / (a.z - b.z));
+	else if (b.z > nearZ)
+		b = mix(b, a, (b.z - nearZ) / (b.z - a.z));
+
+//	***********transform**********
+	// corner.x runs along the segment, corner.y across it. The offset is scaled so the width stays in world
+	// units at the depth of each end.
+	vec4 pa = projection * a;
+	vec4 pb = projection * b;
+	vec2 scale = vec2(projection[0][0], projection[1][1]);
+	vec2 d = (pb.xy / pb.w - pa.xy / pa.w) / scale;
+	vec2 across = length(d) > 0.000001 ? normalize(vec2(-d.y, d.x)) : vec2(0.0, 1.0);
+	wPosition = vec4(mix(segmentStart.xyz, segmentEnd, corner.x), 1.0);
+	pPosition = mix(pa, pb, corner.x);
+	pPosition.xy += across * scale * (segmentStart.w * 0.5 * corner.y);
+	gl_Position = pPosition;
+}
\ No newline at end of file
@@ -3,9 +3,16 @@ precision mediump float;
 
 
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+layout(std140) uniform Draw
+{
+	mat4 model;
+	vec4 diffuseColor;
+};
 
 in vec4 worldPosition;
 in vec4 screenPosition;
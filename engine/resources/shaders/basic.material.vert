@@ -6,10 +6,16 @@ layout(location = 1) in vec4 color;
 layout(location = 2) in vec2 uv;
 layout(location = 3) in vec3 normal;
 
-uniform vec4 diffuseColor;
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+layout(std140) uniform Draw
+{
+	mat4 model;
+	vec4 diffuseColor;
+};
 
 out vec4 vertexColor;
 out vec4 worldPosition;
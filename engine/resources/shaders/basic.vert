@@ -3,9 +3,16 @@ precision mediump float;
 
 layout(location = 0) in vec3 position;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+layout(std140) uniform Draw
+{
+	mat4 model;
+	vec4 diffuseColor;
+};
 
 out vec4 worldPosition;
 out vec4 screenPosition;
@@ -0,0 +1,34 @@
+#version 300 es
+precision mediump float;    
+
+layout(location = 0) in vec3 position;
+layout(location = 3) in vec3 normal;
+layout(location = 4) in mat4 instanceModel;
+
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+
+out vec4 wPosition;
+out vec4 pPosition;
+out vec3 vertexNormal;
+out vec3 pVertexNormal;
+
+void main()
+{
+
+
+//	***********transform**********
+	wPosition = instanceModel * vec4(position, 1.0);
+	pPosition = view * wPosition;
+	gl_Position = projection * pPosition;
+	
+//	***********vertexNormal**********
+	vertexNormal = normalize(normal);
+	
+//	***********clipVertexNormal**********
+	pVertexNormal = vec3(view *  instanceModel * vec4(vertexNormal, 0.0));
+	
+}
\ No newline at end of file
@@ -4,9 +4,16 @@ precision mediump float;
 layout(location = 0) in vec3 position;
 layout(location = 3) in vec3 normal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+layout(std140) uniform Draw
+{
+	mat4 model;
+	vec4 diffuseColor;
+};
 
 out vec4 wPosition;
 out vec4 pPosition;
@@ -26,6 +26,14 @@ def extract_list(v):
         ret.append(list(e.items())[0])
     return ret
 
+# Uniforms the engine uploads through std140 blocks, see UniformBlockBinding in components/render.h. A shader using
+# any member declares the whole block so its layout matches the structs on the C++ side.
+uniform_blocks = [
+    ("Camera", ["mat4 view", "mat4 projection"]),
+    ("Pass", ["vec3 ssaoKernel[64]"]),
+    ("Draw", ["mat4 model", "vec4 diffuseColor"]),
+]
+
 def output_shader(shaders, stage, attrs, uniforms, vars, outs):
     src = []
     attr_src = []
@@ -38,8 +46,14 @@ def output_shader(shaders, stage, attrs, uniforms, vars, outs):
             attr_src.append("layout(location = %s) in %s;" % (attr.loc, attr.declaration()))
     attr_src = "\n".join(attr_src)
 
-    for i, uniform in enumerate(uniforms):
-        uniform_src.append("uniform %s;" % (uniform.declaration()))
+    declared = [uniform.declaration() for uniform in uniforms]
+    for block, members in uniform_blocks:
+        if any(member in declared for member in members):
+            uniform_src.append("layout(std140) uniform %s\n{\n%s\n};" % (
+                block, "\n".join("\t%s;" % member for member in members)))
+            declared = [d for d in declared if d not in members]
+    for declaration in declared:
+        uniform_src.append("uniform %s;" % declaration)
     uniform_src = "\n".join(uniform_src)
 
     for i, var in enumerate(vars):
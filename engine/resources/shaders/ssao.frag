@@ -3,15 +3,21 @@ precision mediump float;
 
 
 
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+layout(std140) uniform Pass
+{
+	vec3 ssaoKernel[64];
+};
 
 uniform sampler2D mapPosition;
 uniform sampler2D mapNormal;
 
 uniform sampler2D ssaoNoiseTexture;
 
-uniform vec3 ssaoKernel[64];
 
 // parameters (you'd probably want to use them as uniforms to more easily tweak the effect)
 int kernelSize = 64;
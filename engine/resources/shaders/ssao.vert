@@ -3,8 +3,11 @@ precision mediump float;
 
 layout(location = 0) in vec3 position;
 
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
 uniform sampler2D mapPosition;
 uniform sampler2D mapNormal;
 
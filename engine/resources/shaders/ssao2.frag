@@ -3,12 +3,18 @@ precision mediump float;
 
 
 
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+layout(std140) uniform Pass
+{
+	vec3 ssaoKernel[64];
+};
 uniform sampler2D mapPosition;
 uniform sampler2D mapNormal;
 uniform sampler2D ssaoNoiseTexture;
-uniform vec3 ssaoKernel[64];
 
 in vec4 pPosition;
 layout(location = 0) out vec4 gColor;
@@ -3,12 +3,18 @@ precision mediump float;
 
 layout(location = 0) in vec3 position;
 
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+layout(std140) uniform Pass
+{
+	vec3 ssaoKernel[64];
+};
 uniform sampler2D mapPosition;
 uniform sampler2D mapNormal;
 uniform sampler2D ssaoNoiseTexture;
-uniform vec3 ssaoKernel[64];
 
 out vec4 pPosition;
 
@@ -3,10 +3,16 @@ precision mediump float;
 
 
 
-uniform vec4 diffuseColor;
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+layout(std140) uniform Draw
+{
+	mat4 model;
+	vec4 diffuseColor;
+};
 uniform sampler2D baseColorTexture;
 uniform sampler2D mapPosition;
 uniform sampler2D mapNormal;
@@ -0,0 +1,44 @@
+#version 300 es
+precision mediump float;    
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+layout(location = 3) in vec2 uv;
+layout(location = 4) in mat4 instanceModel;
+
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+layout(std140) uniform Draw
+{
+	mat4 model;
+	vec4 diffuseColor;
+};
+uniform sampler2D baseColorTexture;
+uniform sampler2D mapPosition;
+uniform sampler2D mapNormal;
+uniform sampler2D mapSSAO;
+
+out vec4 vertexColor;
+out vec2 textureCoords;
+out vec4 wPosition;
+out vec4 pPosition;
+
+void main()
+{
+
+
+//	***********vertexColor**********
+	vertexColor = color;
+	
+//	***********textureCoords**********
+	textureCoords = uv;
+	
+//	***********transform**********
+	wPosition = instanceModel * vec4(position, 1.0);
+	pPosition = projection * view * wPosition;
+	gl_Position = pPosition;
+	
+}
\ No newline at end of file
@@ -5,10 +5,16 @@ layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 color;
 layout(location = 3) in vec2 uv;
 
-uniform vec4 diffuseColor;
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+};
+layout(std140) uniform Draw
+{
+	mat4 model;
+	vec4 diffuseColor;
+};
 uniform sampler2D baseColorTexture;
 uniform sampler2D mapPosition;
 uniform sampler2D mapNormal;
@@ -0,0 +1,252 @@
+#include "aabbtree.h"
+
+#include <algorithm>
+
+static float area(const BBox &box)
+{
+    auto d = box.max - box.min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static bool contains(const BBox &outer, const BBox &inner)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (inner.min[i] < outer.min[i] || inner.max[i] > outer.max[i])
+            return false;
+    }
+    return true;
+}
+
+static bool overlaps(const BBox &a, const BBox &b)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (a.min[i] > b.max[i] || b.min[i] > a.max[i])
+            return false;
+    }
+    return true;
+}
+
+int AABBTree::allocate()
+{
+    if (freeList == none)
+    {
+        nodes.emplace_back();
+        return int(nodes.size()) - 1;
+    }
+    auto node = freeList;
+    freeList = nodes[node].parent;
+    nodes[node] = Node();
+    return node;
+}
+
+void AABBTree::release(int node)
+{
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+int AABBTree::insert(const BBox &box, Handle entity)
+{
+    auto leaf = allocate();
+    auto margin = (box.max - box.min) * 0.1f + vec3(0.001f);
+    nodes[leaf].box = BBox(box.min - margin, box.max + margin);
+    nodes[leaf].tight = box;
+    nodes[leaf].entity = entity;
+    insertLeaf(leaf);
+    leaves++;
+    return leaf;
+}
+
+void AABBTree::remove(int leaf)
+{
+    removeLeaf(leaf);
+    release(leaf);
+    leaves--;
+}
+
+bool AABBTree::update(int leaf, const BBox &box)
+{
+    nodes[leaf].tight = box;
+    if (contains(nodes[leaf].box, box))
+        return false;
+    removeLeaf(leaf);
+    auto margin = (box.max - box.min) * 0.1f + vec3(0.001f);
+    nodes[leaf].box = BBox(box.min - margin, box.max + margin);
+    insertLeaf(leaf);
+    return true;
+}
+
+void AABBTree::insertLeaf(int leaf)
+{
+    if (root == none)
+    {
+        root = leaf;
+        nodes[root].parent = none;
+        return;
+    }
+
+    // Walk down to the sibling that grows the total surface area the least.
+    auto box = nodes[leaf].box;
+    auto index = root;
+    while (!nodes[index].leaf())
+    {
+        auto &node = nodes[index];
+        auto combined = area(node.box + box);
+        auto cost = 2.0f * combined;
+        auto inherited = 2.0f * (combined - area(node.box));
+        float childCost[2];
+        int children[2] = {node.left, node.right};
+        for (int i = 0; i < 2; i++)
+        {
+            auto &child = nodes[children[i]];
+            auto grown = area(child.box + box);
+            childCost[i] = (child.leaf() ? grown : grown - area(child.box)) + inherited;
+        }
+        if (cost < childCost[0] && cost < childCost[1])
+            break;
+        index = childCost[0] < childCost[1] ? children[0] : children[1];
+    }
+
+    auto sibling = index;
+    auto oldParent = nodes[sibling].parent;
+    auto parent = allocate();
+    nodes[parent].parent = oldParent;
+    nodes[parent].box = nodes[sibling].box + box;
+    nodes[parent].height = nodes[sibling].height + 1;
+    nodes[parent].left = sibling;
+    nodes[parent].right = leaf;
+    nodes[sibling].parent = parent;
+    nodes[leaf].parent = parent;
+    if (oldParent == none)
+        root = parent;
+    else if (nodes[oldParent].left == sibling)
+        nodes[oldParent].left = parent;
+    else
+        nodes[oldParent].right = parent;
+
+    refit(nodes[leaf].parent);
+}
+
+void AABBTree::removeLeaf(int leaf)
+{
+    if (leaf == root)
+    {
+        root = none;
+        return;
+    }
+    auto parent = nodes[leaf].parent;
+    auto grandParent = nodes[parent].parent;
+    auto sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+    release(parent);
+    if (grandParent == none)
+    {
+        root = sibling;
+        nodes[sibling].parent = none;
+        return;
+    }
+    if (nodes[grandParent].left == parent)
+        nodes[grandParent].left = sibling;
+    else
+        nodes[grandParent].right = sibling;
+    nodes[sibling].parent = grandParent;
+    refit(grandParent);
+}
+
+void AABBTree::refit(int index)
+{
+    while (index != none)
+    {
+        index = balance(index);
+        auto &node = nodes[index];
+        node.box = nodes[node.left].box + nodes[node.right].box;
+        node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+        index = node.parent;
+    }
+}
+
+// Rotates the taller child up if the subtree at a is out of balance, returns the root of the subtree.
+int AABBTree::balance(int a)
+{
+    auto &A = nodes[a];
+    if (A.leaf() || A.height < 2)
+        return a;
+
+    auto b = A.left, c = A.right;
+    auto diff = nodes[c].height - nodes[b].height;
+    if (diff > 1 || diff < -1)
+    {
+        // Rotate the taller child up into the place of a.
+        auto up = diff > 1 ? c : b;
+        auto other = diff > 1 ? b : c;
+        auto &U = nodes[up];
+        auto f = U.left, g = U.right;
+
+        U.left = a;
+        U.parent = A.parent;
+        A.parent = up;
+        if (U.parent == none)
+            root = up;
+        else if (nodes[U.parent].left == a)
+            nodes[U.parent].left = up;
+        else
+            nodes[U.parent].right = up;
+
+        // The taller grandchild stays under up, the shorter one takes up's place under a.
+        auto keep = nodes[f].height > nodes[g].height ? f : g;
+        auto move = keep == f ? g : f;
+        U.right = keep;
+        if (diff > 1)
+            A.right = move;
+        else
+            A.left = move;
+        nodes[move].parent = a;
+
+        A.box = nodes[other].box + nodes[move].box;
+        A.height = 1 + std::max(nodes[other].height, nodes[move].height);
+        U.box = A.box + nodes[keep].box;
+        U.height = 1 + std::max(A.height, nodes[keep].height);
+        return up;
+    }
+    return a;
+}
+
+Handle AABBTree::raycast(const Ray &ray, float &distance, const std::function<bool(Handle)> &filter) const
+{
+    Handle hit = 0;
+    distance = NO_INTERSECT;
+    walk(
+        [&](const BBox &box) {
+            auto d = box.intersect(ray);
+            return d != NO_INTERSECT && d < distance;
+        },
+        [&](const Node &node) {
+            auto d = node.tight.intersect(ray);
+            if (d < distance && (!filter || filter(node.entity)))
+            {
+                distance = d;
+                hit = node.entity;
+            }
+        });
+    return hit;
+}
+
+void AABBTree::overlap(const BBox &box, std::vector<Handle> &out) const
+{
+    walk([&](const BBox &node) { return overlaps(node, box); },
+         [&](const Node &node) {
+             if (overlaps(node.tight, box))
+                 out.push_back(node.entity);
+         });
+}
+
+void AABBTree::query(const Frustum &frustum, std::vector<Handle> &out) const
+{
+    walk([&](const BBox &box) { return frustum.intersects(box); },
+         [&](const Node &node) {
+             if (frustum.intersects(node.tight))
+                 out.push_back(node.entity);
+         });
+}
@@ -0,0 +1,278 @@
+#include "archetype.h"
+
+#include <algorithm>
+
+Archetype::Archetype(const std::vector<int> &signature) : signature(signature)
+{
+    size_t rowSize = sizeof(Handle);
+    size_t padding = 0;
+    for (auto id : signature)
+    {
+        auto type = ComponentType::byId(id);
+        types.push_back(type);
+        rowSize += type->size;
+        padding += type->align;
+    }
+    capacity = std::max<int>(1, int((CHUNK_SIZE - std::min(padding, CHUNK_SIZE)) / rowSize));
+
+    size_t offset = sizeof(Handle) * capacity;
+    for (auto type : types)
+    {
+        offset = (offset + type->align - 1) / type->align * type->align;
+        offsets.push_back(offset);
+        offset += type->size * capacity;
+    }
+    chunkBytes = std::max(CHUNK_SIZE, offset);
+}
+
+Archetype::~Archetype()
+{
+    while (count)
+    {
+        remove(count - 1);
+    }
+    for (auto chunk : chunks)
+    {
+        ::operator delete(chunk, std::align_val_t(64));
+    }
+}
+
+int Archetype::allocate(Handle entity)
+{
+    if (count == int(chunks.size()) * capacity)
+    {
+        chunks.push_back((unsigned char *)::operator new(chunkBytes, std::align_val_t(64)));
+    }
+    int row = count++;
+    entities(row / capacity)[row % capacity] = entity;
+    return row;
+}
+
+Handle Archetype::remove(int row)
+{
+    int last = count - 1;
+    Handle moved = 0;
+    for (size_t c = 0; c < types.size(); c++)
+    {
+        types[c]->destroy(at(row, c));
+        if (row != last)
+        {
+            types[c]->move(at(row, c), at(last, c));
+            types[c]->destroy(at(last, c));
+        }
+    }
+    if (row != last)
+    {
+        moved = entity(last);
+        entities(row / capacity)[row % capacity] = moved;
+    }
+    count--;
+    return moved;
+}
+
+ArchetypeStorage::ArchetypeStorage()
+{
+}
+
+ArchetypeStorage::~ArchetypeStorage()
+{
+    for (auto arch : archetypes)
+    {
+        delete arch;
+    }
+}
+
+ArchetypeStorage::Location *ArchetypeStorage::find(Handle entity)
+{
+    auto slot = handleIndex(entity);
+    if (slot >= locations.size() || !locations[slot].archetype)
+        return nullptr;
+    auto &loc = locations[slot];
+    return loc.archetype->entity(loc.row) == entity ? &loc : nullptr;
+}
+
+ArchetypeStorage::Location &ArchetypeStorage::location(Handle entity)
+{
+    auto slot = handleIndex(entity);
+    if (slot >= locations.size())
+    {
+        locations.resize(size_t(slot) + 1);
+    }
+    auto &loc = locations[slot];
+    if (loc.archetype && loc.archetype->entity(loc.row) != entity)
+    {
+        // Left behind by a previous generation of this index.
+        move(loc.archetype->entity(loc.row), nullptr, nullptr, nullptr);
+    }
+    return loc;
+}
+
+Archetype *ArchetypeStorage::archetype(const std::vector<int> &signature)
+{
+    if (signature.empty())
+        return nullptr;
+    auto it = archetypeMap.find(signature);
+    if (it != archetypeMap.end())
+        return it->second;
+    auto arch = new Archetype(signature);
+    archetypeMap[signature] = arch;
+    archetypes.push_back(arch);
+    return arch;
+}
+
+void ArchetypeStorage::move(Handle entity, Archetype *target, const ComponentType *added, const void *value)
+{
+    auto &loc = location(entity);
+    auto source = loc.archetype;
+    int row = 0;
+    if (target)
+    {
+        row = target->allocate(entity);
+        for (size_t c = 0; c < target->types.size(); c++)
+        {
+            auto type = target->types[c];
+            int sc = source ? source->column(type->id) : -1;
+            if (sc > -1)
+                type->move(target->at(row, c), source->at(loc.row, sc));
+            else if (added == type && value)
+                type->copy(target->at(row, c), value);
+            else
+                type->construct(target->at(row, c));
+        }
+    }
+    if (source)
+    {
+        if (auto moved = source->remove(loc.row))
+        {
+            locations[handleIndex(moved)].row = loc.row;
+        }
+    }
+    loc.archetype = target;
+    loc.row = row;
+}
+
+void *ArchetypeStorage::get(Handle entity, const ComponentType &type)
+{
+    auto loc = find(entity);
+    if (!loc)
+        return nullptr;
+    int col = loc->archetype->column(type.id);
+    return col > -1 ? loc->archetype->at(loc->row, col) : nullptr;
+}
+
+void *ArchetypeStorage::emplace(Handle entity, const ComponentType &type)
+{
+    if (auto ptr = get(entity, type))
+        return ptr;
+    add(entity, type, nullptr);
+    return get(entity, type);
+}
+
+void ArchetypeStorage::add(Handle entity, const ComponentType &type, const void *value)
+{
+    if (auto ptr = get(entity, type))
+    {
+        if (value)
+            type.assign(ptr, value);
+        return;
+    }
+    auto arch = location(entity).archetype;
+    auto signature = arch ? arch->signature : std::vector<int>();
+    signature.insert(std::upper_bound(signature.begin(), signature.end(), type.id), type.id);
+    move(entity, archetype(signature), &type, value);
+}
+
+void ArchetypeStorage::remove(Handle entity, const ComponentType &type)
+{
+    if (!get(entity, type))
+        return;
+    auto signature = find(entity)->archetype->signature;
+    signature.erase(std::find(signature.begin(), signature.end(), type.id));
+    move(entity, archetype(signature), nullptr, nullptr);
+}
+
+void ArchetypeStorage::remove(Handle entity)
+{
+    if (find(entity))
+        move(entity, nullptr, nullptr, nullptr);
+}
+
+void ArchetypeStorage::copy(Handle source, Handle target)
+{
+    if (source == target || !find(source))
+        return;
+    auto targetArch = location(target).archetype;
+    std::vector<int> signature;
+    auto &sourceSig = find(source)->archetype->signature;
+    auto targetSig = targetArch ? targetArch->signature : std::vector<int>();
+    std::set_union(sourceSig.begin(), sourceSig.end(), targetSig.begin(), targetSig.end(),
+                   std::back_inserter(signature));
+    if (signature != targetSig)
+    {
+        move(target, archetype(signature), nullptr, nullptr);
+    }
+    auto &src = *find(source);
+    auto &dst = *find(target);
+    for (size_t c = 0; c < src.archetype->types.size(); c++)
+    {
+        auto type = src.archetype->types[c];
+        type->assign(dst.archetype->at(dst.row, dst.archetype->column(type->id)), src.archetype->at(src.row, c));
+    }
+}
+
+std::vector<const ComponentType *> ArchetypeStorage::componentTypes(Handle entity)
+{
+    if (auto loc = find(entity))
+        return loc->archetype->types;
+    return {};
+}
+
+std::vector<Handle> ArchetypeStorage::entities(const ComponentType &type)
+{
+    std::vector<Handle> ret;
+    for (auto arch : archetypes)
+    {
+        if (arch->column(type.id) < 0)
+            continue;
+        for (int row = 0; row < arch->count; row++)
+        {
+            ret.push_back(arch->entity(row));
+        }
+    }
+    return ret;
+}
+
+std::vector<Handle> ArchetypeStorage::entities()
+{
+    std::vector<Handle> ret;
+    for (auto arch : archetypes)
+    {
+        for (int row = 0; row < arch->count; row++)
+        {
+            ret.push_back(arch->entity(row));
+        }
+    }
+    return ret;
+}
+
+ArchetypeStorage *ArchetypeStorage::clone()
+{
+    auto cpy = new ArchetypeStorage();
+    for (auto arch : archetypes)
+    {
+        auto target = cpy->archetype(arch->signature);
+        for (int row = 0; row < arch->count; row++)
+        {
+            auto entity = arch->entity(row);
+            auto newRow = target->allocate(entity);
+            for (size_t c = 0; c < arch->types.size(); c++)
+            {
+                arch->types[c]->copy(target->at(newRow, c), arch->at(row, c));
+            }
+            auto &loc = cpy->location(entity);
+            loc.archetype = target;
+            loc.row = newRow;
+        }
+    }
+    return cpy;
+}
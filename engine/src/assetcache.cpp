@@ -0,0 +1,97 @@
+#include "assetcache.h"
+
+#include <filesystem>
+#include <fstream>
+
+std::string AssetCache::canonical(const std::string &path)
+{
+    std::error_code error;
+    auto result = std::filesystem::weakly_canonical(path, error);
+    return error ? path : result.generic_string();
+}
+
+uint64_t AssetCache::hashFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return 0;
+    uint64_t hash = 14695981039346656037ull;
+    char buffer[64 * 1024];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount())
+    {
+        for (std::streamsize i = 0; i < file.gcount(); i++)
+        {
+            hash ^= uint8_t(buffer[i]);
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+Handle AssetCache::find(const std::string &path)
+{
+    auto it = byPath.find(path);
+    if (it == byPath.end())
+        return 0;
+    counters.hits++;
+    return it->second;
+}
+
+Handle AssetCache::alias(const std::string &path, uint64_t hash)
+{
+    auto it = hash ? byHash.find(hash) : byHash.end();
+    if (it == byHash.end())
+        return 0;
+    counters.hits++;
+    byPath[path] = it->second;
+    entries[it->second].paths.push_back(path);
+    return it->second;
+}
+
+void AssetCache::add(const std::string &path, uint64_t hash, Handle proto)
+{
+    counters.misses++;
+    byPath[path] = proto;
+    if (hash)
+        byHash[hash] = proto;
+    entries[proto] = Entry{hash, 0, 0, {path}};
+}
+
+void AssetCache::acquire(Handle proto)
+{
+    auto it = entries.find(proto);
+    if (it != entries.end())
+    {
+        it->second.refs++;
+        it->second.idleFrames = 0;
+    }
+}
+
+void AssetCache::release(Handle proto)
+{
+    auto it = entries.find(proto);
+    if (it != entries.end() && it->second.refs > 0)
+        it->second.refs--;
+}
+
+std::vector<Handle> AssetCache::collect()
+{
+    std::vector<Handle> evicted;
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        auto &entry = it->second;
+        if (entry.refs || ++entry.idleFrames < EVICT_FRAMES)
+        {
+            ++it;
+            continue;
+        }
+        for (auto &path : entry.paths)
+            byPath.erase(path);
+        if (entry.hash)
+            byHash.erase(entry.hash);
+        evicted.push_back(it->first);
+        counters.evictions++;
+        it = entries.erase(it);
+    }
+    return evicted;
+}
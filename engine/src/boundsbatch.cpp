@@ -0,0 +1,75 @@
+#include "boundsbatch.h"
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86_FP)
+#include <xmmintrin.h>
+#define BOUNDS_BATCH_SSE
+#endif
+
+void BoundsBatch::clear()
+{
+    for (auto array : {&cx, &cy, &cz, &ex, &ey, &ez})
+    {
+        array->clear();
+    }
+}
+
+void BoundsBatch::push(const BBox &box)
+{
+    vec3 center(0.0f), extents(1e30f);
+    if (!box.empty)
+    {
+        center = (box.min + box.max) * 0.5f;
+        extents = (box.max - box.min) * 0.5f;
+    }
+    cx.push_back(center.x);
+    cy.push_back(center.y);
+    cz.push_back(center.z);
+    ex.push_back(extents.x);
+    ey.push_back(extents.y);
+    ez.push_back(extents.z);
+}
+
+void BoundsBatch::cull(const Frustum &frustum, std::vector<uint8_t> &visible) const
+{
+    visible.resize(size());
+    size_t i = 0;
+#ifdef BOUNDS_BATCH_SSE
+    // Four boxes per iteration: a box is outside once center distance plus projected radius is negative for a plane.
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= size(); i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&cx[i]), y = _mm_loadu_ps(&cy[i]), z = _mm_loadu_ps(&cz[i]);
+        __m128 rx = _mm_loadu_ps(&ex[i]), ry = _mm_loadu_ps(&ey[i]), rz = _mm_loadu_ps(&ez[i]);
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for (auto &plane : frustum.planes)
+        {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), z), _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(glm::abs(plane.x)), rx), _mm_mul_ps(_mm_set1_ps(glm::abs(plane.y)), ry)),
+                _mm_mul_ps(_mm_set1_ps(glm::abs(plane.z)), rz));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+        }
+        auto mask = _mm_movemask_ps(inside);
+        for (int e = 0; e < 4; e++)
+        {
+            visible[i + e] = (mask >> e) & 1;
+        }
+    }
+#endif
+    for (; i < size(); i++)
+    {
+        visible[i] = 1;
+        for (auto &plane : frustum.planes)
+        {
+            auto distance = plane.x * cx[i] + plane.y * cy[i] + plane.z * cz[i] + plane.w;
+            auto radius = glm::abs(plane.x) * ex[i] + glm::abs(plane.y) * ey[i] + glm::abs(plane.z) * ez[i];
+            if (distance + radius < 0)
+            {
+                visible[i] = 0;
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#include "commandbuffer.h"
+
+#include "registry.h"
+
+CommandBuffer::CommandBuffer(Registry *registry) : registry(registry)
+{
+}
+
+CommandBuffer::~CommandBuffer()
+{
+    clear(false);
+    for (auto block : blocks)
+    {
+        ::operator delete(block, std::align_val_t(64));
+    }
+}
+
+void *CommandBuffer::allocate(size_t size, size_t align)
+{
+    // Payloads that don't fit a block get their own allocation, released on playback.
+    if (size + align > COMMAND_BLOCK_SIZE)
+    {
+        large.push_back((unsigned char *)::operator new(size, std::align_val_t(64)));
+        return large.back();
+    }
+    while (true)
+    {
+        if (block == blocks.size())
+        {
+            blocks.push_back((unsigned char *)::operator new(COMMAND_BLOCK_SIZE, std::align_val_t(64)));
+            used = 0;
+        }
+        auto offset = (used + align - 1) & ~(align - 1);
+        if (offset + size <= COMMAND_BLOCK_SIZE)
+        {
+            used = offset + size;
+            return blocks[block] + offset;
+        }
+        block++;
+        used = 0;
+    }
+}
+
+CommandBuffer::Command *CommandBuffer::record(Handle entity, size_t size, size_t align)
+{
+    auto command = new (allocate(sizeof(Command), alignof(Command))) Command{nullptr, nullptr, entity, nullptr, nullptr};
+    if (size)
+    {
+        command->payload = allocate(size, align);
+    }
+    if (last)
+        last->next = command;
+    else
+        first = command;
+    last = command;
+    return command;
+}
+
+Handle CommandBuffer::createEntity()
+{
+    return registry->nextEntityId();
+}
+
+void CommandBuffer::destroy(Handle entity)
+{
+    record(entity)->apply = [](Registry &registry, Handle entity, void *) { registry.removeEntity(entity); };
+}
+
+void CommandBuffer::clear(bool apply)
+{
+    for (auto command = first; command; command = command->next)
+    {
+        if (apply && command->apply)
+            command->apply(*registry, command->entity, command->payload);
+        if (command->destroy)
+            command->destroy(command->payload);
+    }
+    for (auto payload : large)
+    {
+        ::operator delete(payload, std::align_val_t(64));
+    }
+    large.clear();
+    first = last = nullptr;
+    block = 0;
+    used = 0;
+}
+
+void CommandBuffer::playback()
+{
+    clear(true);
+}
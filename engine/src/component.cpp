@@ -0,0 +1,29 @@
+#include "component.h"
+
+std::vector<ComponentType *> *ComponentType::_types = nullptr;
+std::map<std::string, ComponentType *> *ComponentType::_names = nullptr;
+
+const ComponentType *ComponentType::add(ComponentType *type)
+{
+    if (!_types)
+    {
+        _types = new std::vector<ComponentType *>();
+        _names = new std::map<std::string, ComponentType *>();
+    }
+    type->id = int(_types->size());
+    _types->push_back(type);
+    (*_names)[type->name] = type;
+    return type;
+}
+
+const ComponentType *ComponentType::find(const std::string &name)
+{
+    if (!_names || !_names->count(name))
+        return nullptr;
+    return (*_names)[name];
+}
+
+const ComponentType *ComponentType::byId(int id)
+{
+    return _types && id < int(_types->size()) ? (*_types)[id] : nullptr;
+}
@@ -0,0 +1,70 @@
+#include "debugdraw.h"
+
+std::unordered_map<Registry *, DebugDraw> *DebugDraw::_instances = nullptr;
+
+std::vector<DebugDraw::Segment> &DebugDraw::segments(int layer)
+{
+    for (auto &entry : recorded)
+    {
+        if (entry.mask == layer)
+            return entry.segments;
+    }
+    recorded.push_back({layer});
+    return recorded.back().segments;
+}
+
+void DebugDraw::line(int layer, vec3 a, vec3 b, vec4 color, float width)
+{
+    segments(layer).push_back({a, width, b, 0.0f, color});
+}
+
+void DebugDraw::box(int layer, const BBox &box, const mat4 &transform, vec4 color, float width)
+{
+    vec3 corners[8];
+    for (int i = 0; i < 8; i++)
+    {
+        corners[i] = transform * vec4(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y,
+                                      i & 4 ? box.max.z : box.min.z, 1.0f);
+    }
+    auto &out = segments(layer);
+    // Corners differing in one bit share an edge.
+    for (int i = 0; i < 8; i++)
+    {
+        for (int bit = 1; bit < 8; bit <<= 1)
+        {
+            if (!(i & bit))
+                out.push_back({corners[i], width, corners[i | bit], 0.0f, color});
+        }
+    }
+}
+
+void DebugDraw::circle(int layer, vec3 center, float r, const mat4 &transform, vec4 color, float width,
+                       float startAngle, float endAngle)
+{
+    const int segmentCount = 24;
+    float da = endAngle - startAngle;
+    auto &out = segments(layer);
+    vec3 start = transform * vec4(glm::cos(startAngle) * r, glm::sin(startAngle) * r, 0, 1.0);
+    for (int i = 1; i <= segmentCount; i++)
+    {
+        auto a = (i * da) / segmentCount + startAngle;
+        vec3 end = transform * vec4(glm::cos(a) * r, glm::sin(a) * r, 0, 1.0);
+        out.push_back({start + center, width, end + center, 0.0f, color});
+        start = end;
+    }
+}
+
+void DebugDraw::clear()
+{
+    for (auto &entry : recorded)
+        entry.segments.clear();
+}
+
+DebugDraw *DebugDraw::of(Registry *registry)
+{
+    if (!_instances)
+    {
+        _instances = new std::unordered_map<Registry *, DebugDraw>();
+    }
+    return &(*_instances)[registry];
+}
@@ -0,0 +1,38 @@
+#include "drawlist.h"
+
+#include <cstring>
+
+uint64_t DrawList::makeKey(unsigned pipeline, Handle material, unsigned vao, float depth)
+{
+    // Keys only decide the order, state is still compared when drawing, so folding ids into fewer bits is fine.
+    // Positive floats keep their order when compared as integers, the top 24 bits are enough for sorting.
+    uint32_t depthBits = 0;
+    if (depth > 0.0f)
+        memcpy(&depthBits, &depth, sizeof(depthBits));
+    return uint64_t(pipeline & 0xff) << 56 | uint64_t(handleIndex(material) & 0xffff) << 40 |
+           uint64_t(vao & 0xffff) << 24 | (depthBits >> 7);
+}
+
+void DrawList::sort()
+{
+    scratch.resize(items.size());
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t counts[256] = {};
+        for (auto &item : items)
+            counts[(item.key >> shift) & 0xff]++;
+        if (items.empty() || counts[(items.front().key >> shift) & 0xff] == items.size())
+            continue;
+
+        size_t offset = 0;
+        for (auto &count : counts)
+        {
+            auto n = count;
+            count = offset;
+            offset += n;
+        }
+        for (auto &item : items)
+            scratch[counts[(item.key >> shift) & 0xff]++] = item;
+        items.swap(scratch);
+    }
+}
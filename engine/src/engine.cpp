@@ -20,6 +20,7 @@ Engine* Engine::instance()
 void Engine::addSystem(System* sys)
 {
 	systems.push_back(sys);
+	scheduleDirty = true;
 }
 
 void Engine::start()
@@ -33,15 +34,14 @@ void Engine::start()
 
 void Engine::loop()
 {
-	for (int i=0; i<systems.size(); i++)
+	if (scheduleDirty)
 	{
-        auto sys = systems[i];
-        if (sys)
-        {
-            sys->process();
-            registry.cleanUp();
-        }
+		registry.createStorages();
+		scheduler.build(systems);
+		scheduleDirty = false;
 	}
+	scheduler.run();
+	registry.cleanUp();
 }
 
 Engine::Engine(/* args */)
@@ -60,4 +60,5 @@ void Engine::init()
 void Engine::removeSystem(System* sys)
 {
     std::replace(systems.begin(), systems.end(), sys, (System*)nullptr);
+    scheduleDirty = true;
 }
@@ -0,0 +1,118 @@
+#include "jobsystem.h"
+
+JobSystem *JobSystem::_instance = nullptr;
+thread_local int JobSystem::workerIndex = 0;
+
+JobSystem::JobSystem(int workerCount)
+{
+    for (int i = 0; i <= workerCount; i++)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (int i = 1; i <= workerCount; i++)
+    {
+        threads.emplace_back([this, i]() { workerLoop(i); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    quit = true;
+    wake.notify_all();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void JobSystem::submit(Job job, std::atomic<int> *counter)
+{
+    if (counter)
+        counter->fetch_add(1);
+    // Workers keep their own jobs local, other threads spread theirs over all queues.
+    auto index = workerIndex ? workerIndex : next++ % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->entries.push_back(Entry{std::move(job), counter});
+    }
+    queued++;
+    wake.notify_one();
+}
+
+bool JobSystem::pop(Entry &entry)
+{
+    auto &own = *queues[workerIndex];
+    {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.entries.empty())
+        {
+            entry = std::move(own.entries.back());
+            own.entries.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    for (size_t i = 1; i <= queues.size(); i++)
+    {
+        auto &victim = *queues[(workerIndex + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.entries.empty())
+        {
+            entry = std::move(victim.entries.front());
+            victim.entries.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::run(Entry &entry)
+{
+    entry.job();
+    if (entry.counter)
+        entry.counter->fetch_sub(1);
+}
+
+bool JobSystem::runOne()
+{
+    Entry entry;
+    if (!pop(entry))
+        return false;
+    run(entry);
+    return true;
+}
+
+void JobSystem::wait(std::atomic<int> &counter)
+{
+    while (counter > 0)
+    {
+        if (!runOne())
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::workerLoop(int index)
+{
+    workerIndex = index;
+    while (!quit)
+    {
+        if (runOne())
+            continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait_for(lock, std::chrono::milliseconds(1), [this]() { return quit || queued > 0; });
+    }
+}
+
+JobSystem *JobSystem::instance()
+{
+    if (!_instance)
+    {
+#ifdef EMSCRIPTEN
+        _instance = new JobSystem(0);
+#else
+        _instance = new JobSystem(std::max(1, int(std::thread::hardware_concurrency()) - 1));
+#endif
+    }
+    return _instance;
+}
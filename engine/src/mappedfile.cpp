@@ -0,0 +1,95 @@
+#include "mappedfile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(EMSCRIPTEN)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string &path)
+{
+    auto handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return;
+    file = handle;
+    LARGE_INTEGER fileSize;
+    // Empty files can not be mapped.
+    if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0)
+        return;
+    mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+        return;
+    bytes = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (bytes)
+        length = size_t(fileSize.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+    if (bytes)
+        UnmapViewOfFile(bytes);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+}
+
+#elif defined(EMSCRIPTEN)
+
+MappedFile::MappedFile(const std::string &path)
+{
+    std::ifstream is(path, std::ios::binary | std::ios::ate);
+    if (!is)
+        return;
+    buffer.resize(size_t(is.tellg()));
+    is.seekg(0);
+    if (buffer.empty() || !is.read((char *)buffer.data(), buffer.size()))
+        return;
+    bytes = buffer.data();
+    length = buffer.size();
+}
+
+MappedFile::~MappedFile()
+{
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        auto mapped = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED)
+        {
+            // The whole file is read front to back.
+            madvise(mapped, size_t(st.st_size), MADV_SEQUENTIAL);
+            bytes = (const uint8_t *)mapped;
+            length = size_t(st.st_size);
+        }
+    }
+    // The mapping stays valid once the descriptor is closed.
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (bytes)
+        munmap((void *)bytes, length);
+}
+
+#endif
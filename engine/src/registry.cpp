@@ -1,31 +1,181 @@
 #include "Registry.h"
 #include "Storage.h"
+#include "mappedfile.h"
 
+#include <algorithm>
+#include <fstream>
 #include <unordered_set>
 
-Registry::Registry(/* args */)
+Registry::Registry(Backend backend)
 {
+    if (backend == Backend::Archetype)
+    {
+        archetypes = new ArchetypeStorage();
+    }
+    for (int i = 0; i <= JobSystem::instance()->workerCount(); i++)
+    {
+        threadCommands.push_back(new CommandBuffer(this));
+    }
 }
 
 Registry::~Registry()
 {
+    delete archetypes;
+    for (auto &kv : storages)
+    {
+        delete kv.second;
+    }
+    for (auto &kv : views)
+    {
+        delete kv.second;
+    }
+    for (auto commands : threadCommands)
+    {
+        delete commands;
+    }
+}
+
+void Registry::createStorages()
+{
+    if (archetypes)
+        return;
+    for (int id = 0; auto type = ComponentType::byId(id); id++)
+    {
+        // Types only known through ComponentType::of() have no storage constructor.
+        if (!StorageBase::constructors()->count(type->name))
+            continue;
+        if (id >= int(storageIndex.size()))
+            storageIndex.resize(size_t(id) + 1, nullptr);
+        if (!storageIndex[id])
+            storageIndex[id] = storage(type->name);
+    }
 }
 
 void Registry::cleanUp()
 {
+    destroyed = 0;
+    for (auto storage : storages)
+    {
+        storage.second->releaseRetired();
+    }
+    if (released.empty())
+        return;
+
+    std::sort(released.begin(), released.end());
+    released.erase(std::unique(released.begin(), released.end()), released.end());
+
+    if (listener)
+    {
+        for (auto entity : released)
+            removing(entity);
+    }
+    if (archetypes)
+    {
+        for (auto entity : released)
+            archetypes->remove(entity);
+    }
+    for (auto storage : storages)
+    {
+        storage.second->remove(released);
+    }
+    for (auto &kv : views)
+    {
+        for (auto entity : released)
+            kv.second->update(entity);
+    }
     for (auto entity : released)
     {
-        for (auto storage : storages)
+        recycle(entity);
+    }
+    destroyed = released.size();
+    released.clear();
+}
+
+thread_local Registry *Registry::walking = nullptr;
+
+void Registry::flushDeferred()
+{
+    for (auto commands : threadCommands)
+    {
+        commands->playback();
+    }
+}
+
+Handle Registry::nextEntityId()
+{
+    // par_each callbacks and worker systems may create entities from several threads at once.
+    std::lock_guard<std::mutex> lock(entityMutex);
+    while (!freeIndices.empty())
+    {
+        auto index = freeIndices.back();
+        freeIndices.pop_back();
+        // Indices claimed by fromJson may still sit in the free list.
+        if (!alive[index])
         {
-            storage.second->remove(entity);
+            auto entity = makeHandle(index, generations[index]);
+            if (listener)
+                listener->entityChanging(entity, false);
+            alive[index] = true;
+            return entity;
         }
     }
+    auto index = entityCounter++;
+    generations.resize(size_t(index) + 1, 0);
+    newestGenerations.resize(size_t(index) + 1, 0);
+    alive.resize(size_t(index) + 1, false);
+    if (listener)
+        listener->entityChanging(makeHandle(index, 0), false);
+    alive[index] = true;
+    return makeHandle(index, 0);
+}
+
+void Registry::claim(Handle entity)
+{
+    if (listener)
+        listener->entityChanging(entity, valid(entity));
+    std::lock_guard<std::mutex> lock(entityMutex);
+    auto index = handleIndex(entity);
+    if (index >= entityCounter)
+    {
+        generations.resize(size_t(index) + 1, 0);
+        newestGenerations.resize(size_t(index) + 1, 0);
+        alive.resize(size_t(index) + 1, false);
+        for (auto i = entityCounter; i < index; i++)
+        {
+            freeIndices.push_back(i);
+        }
+        entityCounter = index + 1;
+    }
+    generations[index] = handleGeneration(entity);
+    newestGenerations[index] = std::max(newestGenerations[index], generations[index]);
+    alive[index] = true;
+}
+
+bool Registry::revive(Handle entity)
+{
+    auto index = handleIndex(entity);
+    if (index < entityCounter && alive[index])
+        return generations[index] == handleGeneration(entity);
+    claim(entity);
+    return true;
 }
 
 std::map<Handle, EntityInfo> Registry::entities()
 {
     std::map<Handle, EntityInfo> set;
 
+    if (archetypes)
+    {
+        for (auto handle : archetypes->entities())
+        {
+            set[handle].handle = handle;
+            for (auto type : archetypes->componentTypes(handle))
+            {
+                set[handle].components.push_back(std::string(type->name).replace(0, 6, ""));
+            }
+        }
+    }
+
 	for (auto kv: storages)
 	{        
         for (auto handle : kv.second->entities())
@@ -37,17 +187,55 @@ std::map<Handle, EntityInfo> Registry::entities()
     return set;
 }
 
+void Registry::removing(Handle entity)
+{
+    if (!listener || !valid(entity))
+        return;
+    for (auto type : componentTypes(entity))
+        listener->componentChanging(entity, *type);
+    listener->entityChanging(entity, true);
+}
+
+std::vector<const ComponentType *> Registry::componentTypes(Handle entity)
+{
+    if (archetypes)
+        return archetypes->componentTypes(entity);
+    std::vector<const ComponentType *> types;
+    for (auto &kv : storages)
+    {
+        if (kv.second->has(entity))
+        {
+            if (auto type = ComponentType::find(kv.first))
+                types.push_back(type);
+        }
+    }
+    return types;
+}
+
 void Registry::release(Handle entity)
 {
+    std::lock_guard<std::mutex> lock(entityMutex);
     released.push_back(entity);
 }
 
-void Registry::toJson(std::vector<int>& entities, json& out)
+void Registry::toJson(std::vector<Handle>& entities, json& out)
 {
     out = json::object();
     for (auto entity : entities)
     {
         auto j = json::object();        
+        if (archetypes)
+        {
+            for (auto type : archetypes->componentTypes(entity))
+            {
+                if (type->serializable)
+                {
+                    auto jc = json::object();
+                    type->serialize(archetypes->get(entity, *type), jc);
+                    j[type->name] = jc;
+                }
+            }
+        }
         for (auto stor : storages)
         {
             if (stor.second->isSerializable() && stor.second->has(entity))
@@ -65,11 +253,235 @@ void Registry::fromJson(json &j)
 {
     for (auto el: j.items())
     {        
-        Handle entity = std::stoi(el.key());
+        Handle entity = std::stoull(el.key());
+        claim(entity);
         for (auto cel : el.value().items())
         {
-            auto &val = cel.value();
-            storage(cel.key())->unserialize(entity, val);
+            componentFromJson(entity, cel.key(), cel.value());
         }        
+        notifyAll(entity);
     }
 }
+
+void Registry::componentFromJson(Handle entity, const std::string &typeName, json &j)
+{
+    // Types unknown to this build are skipped.
+    auto type = ComponentType::find(typeName);
+    if (!type)
+        return;
+    changing(entity, *type);
+    if (archetypes)
+    {
+        type->unserialize(archetypes->emplace(entity, *type), j);
+        return;
+    }
+    storage(typeName)->unserialize(entity, j);
+}
+
+const void *Registry::rawComponent(Handle entity, const ComponentType &type)
+{
+    if (archetypes)
+        return archetypes->get(entity, type);
+    auto it = storages.find(type.name);
+    return it != storages.end() ? it->second->getRaw(entity) : nullptr;
+}
+
+void *Registry::emplaceComponent(Handle entity, const ComponentType &type)
+{
+    changing(entity, type);
+    if (archetypes)
+        return archetypes->emplace(entity, type);
+    return storage(type.name)->emplaceRaw(entity);
+}
+
+void Registry::removeComponent(Handle entity, const ComponentType &type)
+{
+    changing(entity, type);
+    if (archetypes)
+        archetypes->remove(entity, type);
+    else if (storages.count(type.name))
+        storages[type.name]->remove(entity);
+    notify(type.id, entity);
+}
+
+void Registry::toBinary(std::vector<Handle> &entities, std::vector<uint8_t> &out)
+{
+    BinaryWriter w{out};
+    w.value(SCENE_BINARY_MAGIC);
+    w.value(SCENE_BINARY_VERSION);
+    w.value(uint64_t(entities.size()));
+    w.bytes(entities.data(), entities.size() * sizeof(Handle));
+
+    // Rows of every column in the order of entities, columns in component id order.
+    std::map<int, std::vector<Handle>> columns;
+    for (auto entity : entities)
+    {
+        if (archetypes)
+        {
+            for (auto type : archetypes->componentTypes(entity))
+            {
+                if (type->serializable)
+                    columns[type->id].push_back(entity);
+            }
+        }
+        for (auto stor : storages)
+        {
+            if (stor.second->isSerializable() && stor.second->has(entity))
+            {
+                if (auto type = ComponentType::find(stor.first))
+                    columns[type->id].push_back(entity);
+            }
+        }
+    }
+
+    w.value(uint32_t(columns.size()));
+    for (auto &column : columns)
+    {
+        auto type = ComponentType::byId(column.first);
+        auto &fields = type->fields;
+        auto blockStart = out.size();
+        w.value(uint64_t(0));
+
+        w.string(type->name);
+        w.value(uint32_t(fields.size()));
+        for (auto &field : fields)
+        {
+            w.string(field.name);
+            w.value(uint32_t(field.podSize));
+        }
+        auto &rows = column.second;
+        w.value(uint64_t(rows.size()));
+        w.bytes(rows.data(), rows.size() * sizeof(Handle));
+
+        for (auto entity : rows)
+        {
+            auto component = rawComponent(entity, *type);
+            for (auto &field : fields)
+            {
+                if (field.podSize)
+                {
+                    field.write(component, w);
+                    continue;
+                }
+                // Variable sized fields are length prefixed so readers can skip them.
+                auto fieldStart = out.size();
+                w.value(uint32_t(0));
+                field.write(component, w);
+                auto fieldSize = uint32_t(out.size() - fieldStart - sizeof(uint32_t));
+                memcpy(&out[fieldStart], &fieldSize, sizeof(fieldSize));
+            }
+        }
+        auto blockSize = uint64_t(out.size() - blockStart - sizeof(uint64_t));
+        memcpy(&out[blockStart], &blockSize, sizeof(blockSize));
+    }
+}
+
+void Registry::fromBinary(const uint8_t *data, size_t size)
+{
+    // The first pass decodes into scratch components only, so truncated or corrupt data throws before anything in
+    // the registry changed.
+    readScene(data, size, false);
+    readScene(data, size, true);
+}
+
+void Registry::readScene(const uint8_t *data, size_t size, bool apply)
+{
+    BinaryReader r{data, data + size};
+    if (r.value<uint32_t>() != SCENE_BINARY_MAGIC)
+        throw std::runtime_error("Not a binary scene");
+    if (r.value<uint32_t>() > SCENE_BINARY_VERSION)
+        throw std::runtime_error("Binary scene was written by a newer version");
+
+    auto entityCount = r.count<uint64_t>(sizeof(Handle));
+    auto handles = r.bytes(entityCount * sizeof(Handle));
+    std::vector<Handle> entities(entityCount);
+    memcpy(entities.data(), handles, entityCount * sizeof(Handle));
+    if (apply)
+    {
+        for (auto entity : entities)
+            claim(entity);
+    }
+
+    auto columnCount = r.value<uint32_t>();
+    for (uint32_t c = 0; c < columnCount; c++)
+    {
+        auto blockSize = r.value<uint64_t>();
+        auto block = r.bytes(blockSize);
+        BinaryReader column{block, block + blockSize};
+
+        auto type = ComponentType::find(column.string());
+        if (!type)
+            continue;
+        // Fields of the file matched to this build by name, nullptr when missing or changed size.
+        struct Field
+        {
+            const FieldInfo *info;
+            uint32_t size;
+        };
+        std::vector<Field> fields(column.count<uint32_t>(2 * sizeof(uint32_t)));
+        for (auto &field : fields)
+        {
+            auto name = column.string();
+            field.size = column.value<uint32_t>();
+            field.info = nullptr;
+            for (auto &known : type->fields)
+            {
+                if (known.name == name && known.podSize == field.size)
+                    field.info = &known;
+            }
+        }
+
+        auto rowCount = column.count<uint64_t>(sizeof(Handle));
+        auto handles = column.bytes(rowCount * sizeof(Handle));
+        std::vector<Handle> rows(rowCount);
+        memcpy(rows.data(), handles, rowCount * sizeof(Handle));
+        std::unique_ptr<ScratchComponent> scratch;
+        if (!apply)
+            scratch.reset(new ScratchComponent(*type));
+        for (auto entity : rows)
+        {
+            auto component = apply ? emplaceComponent(entity, *type) : scratch->get();
+            for (auto &field : fields)
+            {
+                if (field.size)
+                {
+                    auto bytes = column.bytes(field.size);
+                    if (field.info)
+                        memcpy(field.info->address(component), bytes, field.size);
+                    continue;
+                }
+                auto fieldSize = column.value<uint32_t>();
+                auto bytes = column.bytes(fieldSize);
+                if (field.info)
+                {
+                    BinaryReader value{bytes, bytes + fieldSize};
+                    field.info->read(component, value);
+                }
+            }
+        }
+    }
+
+    if (apply)
+    {
+        for (auto entity : entities)
+            notifyAll(entity);
+    }
+}
+
+bool Registry::saveBinary(std::vector<Handle> &entities, const std::string &path)
+{
+    std::vector<uint8_t> out;
+    toBinary(entities, out);
+    std::ofstream os(path, std::ios::binary);
+    os.write((const char *)out.data(), out.size());
+    return bool(os);
+}
+
+bool Registry::loadBinary(const std::string &path)
+{
+    MappedFile file(path);
+    if (!file.valid())
+        return false;
+    fromBinary(file.data(), file.size());
+    return true;
+}
@@ -0,0 +1,238 @@
+#include "sceneloader.h"
+
+#include <cstdlib>
+#include <fstream>
+
+namespace
+{
+// Nesting of the scene file: the root object maps handles to entity objects, those map component type names to
+// component objects, which are built as json and handed on once closed.
+const int ENTITY_DEPTH = 1;
+const int TYPE_DEPTH = 2;
+const int COMPONENT_DEPTH = 3;
+
+template <typename F> struct SceneSax
+{
+    F &emit;
+    int depth = 0;
+    Handle entity = 0;
+    std::string type;
+    std::string field;
+    json component;
+    std::vector<json *> stack;
+    std::string error;
+
+    // Adds value to the json being built, values outside of a component are ignored.
+    json *add(json &&value)
+    {
+        if (stack.empty())
+            return nullptr;
+        auto top = stack.back();
+        if (top->is_object())
+            return &((*top)[field] = std::move(value));
+        top->push_back(std::move(value));
+        return &top->back();
+    }
+
+    bool open(json &&container)
+    {
+        depth++;
+        if (depth == COMPONENT_DEPTH)
+        {
+            component = std::move(container);
+            stack.push_back(&component);
+        }
+        else if (depth > COMPONENT_DEPTH)
+        {
+            stack.push_back(add(std::move(container)));
+        }
+        return true;
+    }
+
+    bool close()
+    {
+        bool more = true;
+        if (depth >= COMPONENT_DEPTH)
+            stack.pop_back();
+        if (depth == COMPONENT_DEPTH)
+            more = emit(SceneLoader::Row{SceneLoader::Row::Component, entity, type, std::move(component)});
+        else if (depth == TYPE_DEPTH)
+            more = emit(SceneLoader::Row{SceneLoader::Row::End, entity, {}, {}});
+        depth--;
+        return more;
+    }
+
+    template <typename T> bool value(T &&v)
+    {
+        add(json(std::forward<T>(v)));
+        return true;
+    }
+
+    bool null()
+    {
+        return value(nullptr);
+    }
+    bool boolean(bool val)
+    {
+        return value(val);
+    }
+    bool number_integer(json::number_integer_t val)
+    {
+        return value(val);
+    }
+    bool number_unsigned(json::number_unsigned_t val)
+    {
+        return value(val);
+    }
+    bool number_float(json::number_float_t val, const json::string_t &)
+    {
+        return value(val);
+    }
+    bool string(json::string_t &val)
+    {
+        return value(val);
+    }
+    bool binary(json::binary_t &val)
+    {
+        return value(json::binary(val));
+    }
+    bool start_object(size_t)
+    {
+        return open(json::object());
+    }
+    bool end_object()
+    {
+        return close();
+    }
+    bool start_array(size_t)
+    {
+        return open(json::array());
+    }
+    bool end_array()
+    {
+        return close();
+    }
+    bool key(json::string_t &val)
+    {
+        if (depth == ENTITY_DEPTH)
+        {
+            char *end;
+            entity = std::strtoull(val.c_str(), &end, 10);
+            if (*end)
+            {
+                error = "Invalid entity " + val;
+                return false;
+            }
+            return emit(SceneLoader::Row{SceneLoader::Row::Begin, entity, {}, {}});
+        }
+        if (depth == TYPE_DEPTH)
+            type = val;
+        else
+            field = val;
+        return true;
+    }
+    bool parse_error(size_t, const std::string &, const json::exception &ex)
+    {
+        error = ex.what();
+        return false;
+    }
+};
+} // namespace
+
+SceneLoader::SceneLoader(Registry *registry, const std::string &path) : registry(registry), path(path)
+{
+}
+
+SceneLoader::~SceneLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+    }
+    changed.notify_all();
+    if (parser.joinable())
+        parser.join();
+}
+
+template <typename F> bool SceneLoader::parse(F &&emit)
+{
+    std::ifstream is(path);
+    if (!is)
+    {
+        error = "Could not open " + path;
+        return false;
+    }
+    SceneSax<F> sax{emit};
+    auto result = json::sax_parse(is, &sax);
+    if (!result && error.empty())
+        error = sax.error.empty() ? "Could not parse " + path : sax.error;
+    return result;
+}
+
+bool SceneLoader::load()
+{
+    return parse([&](Row &&row) {
+        apply(row);
+        return true;
+    });
+}
+
+bool SceneLoader::step(std::chrono::microseconds budget)
+{
+    if (!started)
+    {
+        started = true;
+        if (JobSystem::instance()->workerCount() == 0)
+        {
+            load();
+            return true;
+        }
+        // Not a job, the parser blocks while the queue is full and would hold a worker for the whole file.
+        parser = std::thread([this]() {
+            parse([&](Row &&row) {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return queue.size() < QUEUE_LIMIT || cancelled; });
+                if (cancelled)
+                    return false;
+                queue.push_back(std::move(row));
+                return true;
+            });
+            // The main thread only reads error once parsed is set.
+            std::lock_guard<std::mutex> lock(mutex);
+            parsed = true;
+        });
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + budget;
+    do
+    {
+        Row row;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.empty())
+                return parsed;
+            row = std::move(queue.front());
+            queue.pop_front();
+        }
+        changed.notify_one();
+        apply(row);
+    } while (std::chrono::steady_clock::now() < deadline);
+    return false;
+}
+
+void SceneLoader::apply(Row &row)
+{
+    switch (row.kind)
+    {
+    case Row::Begin:
+        registry->claim(row.entity);
+        break;
+    case Row::Component:
+        registry->componentFromJson(row.entity, row.type, row.value);
+        break;
+    case Row::End:
+        registry->loaded(row.entity);
+        entityCount++;
+        break;
+    }
+}
@@ -0,0 +1,118 @@
+#include "scheduler.h"
+
+#include "jobsystem.h"
+#include "systems/system.h"
+
+#include <algorithm>
+#include <thread>
+
+static bool overlaps(const std::vector<int> &a, const std::vector<int> &b)
+{
+    for (auto id : a)
+    {
+        if (std::find(b.begin(), b.end(), id) != b.end())
+            return true;
+    }
+    return false;
+}
+
+bool Scheduler::conflicts(const System &a, const System &b)
+{
+    if (!a.declared() || !b.declared())
+        return true;
+    return overlaps(a.writing, b.reading) || overlaps(a.writing, b.writing) || overlaps(b.writing, a.reading);
+}
+
+void Scheduler::build(const std::vector<System *> &systems)
+{
+    nodes.clear();
+    for (auto sys : systems)
+    {
+        if (sys)
+            nodes.push_back(Node{sys});
+    }
+    // Edges only point forward, so the order systems were added in stays the order conflicting systems run in.
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        for (size_t j = i + 1; j < nodes.size(); j++)
+        {
+            if (conflicts(*nodes[i].system, *nodes[j].system))
+            {
+                nodes[i].dependents.push_back(int(j));
+                nodes[j].dependencies++;
+            }
+        }
+    }
+    remaining.reset(new std::atomic<int>[nodes.size()]);
+    jobs = JobSystem::instance();
+    warm = false;
+}
+
+void Scheduler::schedule(int node)
+{
+    if (nodes[node].system->mainThread || !jobs->workerCount())
+    {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        mainReady.push_back(node);
+        return;
+    }
+    jobs->submit([this, node]() {
+        nodes[node].system->process();
+        finish(node);
+    });
+}
+
+void Scheduler::finish(int node)
+{
+    for (auto dependent : nodes[node].dependents)
+    {
+        if (--remaining[dependent] == 0)
+            schedule(dependent);
+    }
+    pending--;
+}
+
+void Scheduler::run()
+{
+    // The first frame runs serially so other state the systems create lazily, like their singletons, exists
+    // before any of it is touched from more than one thread. Storages are created before the graph is built and
+    // views under a lock.
+    if (!warm)
+    {
+        for (auto &node : nodes)
+            node.system->process();
+        warm = true;
+        return;
+    }
+
+    pending = int(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+        remaining[i] = nodes[i].dependencies;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        if (!nodes[i].dependencies)
+            schedule(int(i));
+    }
+
+    while (pending > 0)
+    {
+        int node = -1;
+        {
+            std::lock_guard<std::mutex> lock(mainMutex);
+            if (!mainReady.empty())
+            {
+                node = mainReady.front();
+                mainReady.erase(mainReady.begin());
+            }
+        }
+        if (node > -1)
+        {
+            nodes[node].system->process();
+            finish(node);
+        }
+        else if (!jobs->runOne())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,386 @@
+#include "snapshots.h"
+#include "mappedfile.h"
+
+#include <filesystem>
+#include <fstream>
+
+// Journals written by saveIncremental start with this magic and version.
+const uint32_t JOURNAL_MAGIC = 0x4a534345;
+const uint32_t JOURNAL_VERSION = 1;
+
+namespace
+{
+struct EntityRecord
+{
+    Handle entity;
+    bool alive;
+};
+
+struct ComponentRecord
+{
+    Handle entity;
+    const ComponentType *type;
+    bool present;
+    const uint8_t *bytes;
+    uint32_t size;
+};
+
+void writeImage(BinaryWriter &w, bool present, const std::vector<uint8_t> &bytes)
+{
+    w.value(uint8_t(present));
+    w.value(uint32_t(bytes.size()));
+    w.bytes(bytes.data(), bytes.size());
+}
+
+void readImage(BinaryReader &r, ComponentRecord &record)
+{
+    record.present = r.value<uint8_t>() != 0;
+    record.size = r.value<uint32_t>();
+    record.bytes = r.bytes(record.size);
+}
+
+// Brings entities and components to the recorded state: entities are destroyed first, so their indices are free
+// again, then revived before their components are set. The order of the records does not matter. Entities whose
+// index went to an entity created without being recorded stay destroyed, along with their components.
+void applyRecords(Registry *registry, const std::vector<EntityRecord> &entities,
+                  const std::vector<ComponentRecord> &components)
+{
+    for (auto &record : entities)
+    {
+        if (!record.alive && registry->valid(record.entity))
+            registry->removeEntity(record.entity);
+    }
+    for (auto &record : entities)
+    {
+        if (record.alive && !registry->valid(record.entity))
+            registry->revive(record.entity);
+    }
+    for (auto &record : components)
+    {
+        if (!registry->valid(record.entity))
+            continue;
+        if (record.present)
+        {
+            auto component = registry->emplaceComponent(record.entity, *record.type);
+            BinaryReader r{record.bytes, record.bytes + record.size};
+            for (auto &field : record.type->fields)
+                field.read(component, r);
+        }
+        else if (registry->rawComponent(record.entity, *record.type))
+        {
+            registry->removeComponent(record.entity, *record.type);
+        }
+    }
+    for (auto &record : components)
+    {
+        if (record.present && registry->valid(record.entity))
+            registry->loaded(record.entity);
+    }
+}
+} // namespace
+
+Snapshots::Snapshots(Registry *registry, size_t budget) : registry(registry), budget(budget)
+{
+    registry->listen(this);
+}
+
+Snapshots::~Snapshots()
+{
+    registry->listen(nullptr);
+}
+
+Snapshots::Image Snapshots::capture(Handle entity, const ComponentType &type)
+{
+    Image image;
+    auto component = registry->valid(entity) ? registry->rawComponent(entity, type) : nullptr;
+    if (component)
+    {
+        image.present = true;
+        BinaryWriter w{image.bytes};
+        for (auto &field : type.fields)
+            field.write(component, w);
+    }
+    return image;
+}
+
+void Snapshots::componentChanging(Handle entity, const ComponentType &type)
+{
+    if (applying || !recording || type.fields.empty())
+        return;
+    if (type.id >= int(dirty.size()))
+        dirty.resize(size_t(type.id) + 1);
+    auto &set = dirty[type.id];
+    if (!set.count(entity))
+        set.emplace(entity, capture(entity, type));
+}
+
+void Snapshots::entityChanging(Handle entity, bool alive)
+{
+    if (!applying && recording)
+        dirtyEntities.emplace(entity, alive);
+}
+
+void Snapshots::markUnsaved(Handle entity, int typeId)
+{
+    if (typeId < 0)
+    {
+        unsavedEntities.insert(entity);
+        return;
+    }
+    if (typeId >= int(unsaved.size()))
+        unsaved.resize(size_t(typeId) + 1);
+    unsaved[typeId].insert(entity);
+}
+
+bool Snapshots::commit()
+{
+    std::vector<uint8_t> delta;
+    BinaryWriter w{delta};
+
+    w.value(uint32_t(0));
+    uint32_t entityCount = 0;
+    for (auto &kv : dirtyEntities)
+    {
+        auto alive = registry->valid(kv.first);
+        if (alive == kv.second)
+            continue;
+        w.value(kv.first);
+        w.value(uint8_t(kv.second));
+        w.value(uint8_t(alive));
+        markUnsaved(kv.first, -1);
+        entityCount++;
+    }
+    memcpy(delta.data(), &entityCount, sizeof(entityCount));
+
+    auto componentsAt = delta.size();
+    w.value(uint32_t(0));
+    uint32_t componentCount = 0;
+    for (size_t id = 0; id < dirty.size(); id++)
+    {
+        auto &type = *ComponentType::byId(int(id));
+        for (auto &kv : dirty[id])
+        {
+            auto &before = kv.second;
+            auto after = capture(kv.first, type);
+            if (before.present == after.present && before.bytes == after.bytes)
+                continue;
+            w.value(uint32_t(id));
+            w.value(kv.first);
+            writeImage(w, before.present, before.bytes);
+            writeImage(w, after.present, after.bytes);
+            markUnsaved(kv.first, int(id));
+            componentCount++;
+        }
+        dirty[id].clear();
+    }
+    memcpy(delta.data() + componentsAt, &componentCount, sizeof(componentCount));
+    dirtyEntities.clear();
+
+    if (!entityCount && !componentCount)
+        return false;
+    push(std::move(delta));
+    return true;
+}
+
+void Snapshots::push(std::vector<uint8_t> &&delta)
+{
+    // A new step replaces everything that could have been redone.
+    while (ring.size() > cursor)
+    {
+        ringBytes -= ring.back().size();
+        ring.pop_back();
+    }
+    ringBytes += delta.size();
+    ring.push_back(std::move(delta));
+    cursor++;
+    while (ringBytes > budget && ring.size() > 1)
+    {
+        ringBytes -= ring.front().size();
+        ring.pop_front();
+        cursor--;
+        dropped++;
+    }
+}
+
+void Snapshots::apply(const std::vector<uint8_t> &delta, bool after)
+{
+    BinaryReader r{delta.data(), delta.data() + delta.size()};
+    std::vector<EntityRecord> entities(r.value<uint32_t>());
+    for (auto &record : entities)
+    {
+        record.entity = r.value<Handle>();
+        auto before = r.value<uint8_t>() != 0;
+        auto now = r.value<uint8_t>() != 0;
+        record.alive = after ? now : before;
+        markUnsaved(record.entity, -1);
+    }
+    std::vector<ComponentRecord> components(r.value<uint32_t>());
+    for (auto &record : components)
+    {
+        record.type = ComponentType::byId(int(r.value<uint32_t>()));
+        record.entity = r.value<Handle>();
+        ComponentRecord before, now;
+        readImage(r, before);
+        readImage(r, now);
+        auto &target = after ? now : before;
+        record.present = target.present;
+        record.bytes = target.bytes;
+        record.size = target.size;
+        markUnsaved(record.entity, record.type->id);
+    }
+    applying = true;
+    applyRecords(registry, entities, components);
+    applying = false;
+}
+
+bool Snapshots::undo()
+{
+    commit();
+    if (!canUndo())
+        return false;
+    apply(ring[--cursor], false);
+    return true;
+}
+
+bool Snapshots::redo()
+{
+    commit();
+    if (!canRedo())
+        return false;
+    apply(ring[cursor++], true);
+    return true;
+}
+
+bool Snapshots::restore(size_t target)
+{
+    commit();
+    if (target < dropped || target > dropped + ring.size())
+        return false;
+    while (position() > target)
+        undo();
+    while (position() < target)
+        redo();
+    return true;
+}
+
+void Snapshots::clear()
+{
+    dirty.clear();
+    dirtyEntities.clear();
+    ring.clear();
+    cursor = 0;
+    dropped = 0;
+    ringBytes = 0;
+    saved();
+}
+
+bool Snapshots::saveIncremental(const std::string &path, const std::function<bool(Handle)> &include)
+{
+    commit();
+    std::vector<uint8_t> out;
+    BinaryWriter w{out};
+    std::error_code error;
+    if (!std::filesystem::exists(path, error) || std::filesystem::file_size(path, error) == 0)
+    {
+        w.value(JOURNAL_MAGIC);
+        w.value(JOURNAL_VERSION);
+    }
+
+    auto blockAt = out.size();
+    w.value(uint64_t(0));
+    auto countAt = out.size();
+    w.value(uint32_t(0));
+    uint32_t entityCount = 0;
+    for (auto entity : unsavedEntities)
+    {
+        if (include && !include(entity))
+            continue;
+        w.value(entity);
+        w.value(uint8_t(registry->valid(entity)));
+        entityCount++;
+    }
+    memcpy(&out[countAt], &entityCount, sizeof(entityCount));
+
+    countAt = out.size();
+    w.value(uint32_t(0));
+    uint32_t componentCount = 0;
+    for (size_t id = 0; id < unsaved.size(); id++)
+    {
+        auto &type = *ComponentType::byId(int(id));
+        for (auto entity : unsaved[id])
+        {
+            if (include && !include(entity))
+                continue;
+            auto image = capture(entity, type);
+            w.string(type.name);
+            w.value(entity);
+            writeImage(w, image.present, image.bytes);
+            componentCount++;
+        }
+    }
+    memcpy(&out[countAt], &componentCount, sizeof(componentCount));
+    auto blockSize = uint64_t(out.size() - blockAt - sizeof(uint64_t));
+    memcpy(&out[blockAt], &blockSize, sizeof(blockSize));
+
+    std::ofstream os(path, std::ios::binary | std::ios::app);
+    os.write((const char *)out.data(), out.size());
+    if (!os)
+        return false;
+    saved();
+    return true;
+}
+
+bool Snapshots::loadIncremental(Registry *registry, const std::string &path)
+{
+    MappedFile file(path);
+    if (!file.valid())
+        return false;
+    BinaryReader r{file.data(), file.data() + file.size()};
+    if (r.value<uint32_t>() != JOURNAL_MAGIC || r.value<uint32_t>() != JOURNAL_VERSION)
+        return false;
+
+    // Everything is read and decoded before the first block is applied, so a truncated journal or one written with
+    // another component layout throws without touching the registry.
+    struct Block
+    {
+        std::vector<EntityRecord> entities;
+        std::vector<ComponentRecord> components;
+    };
+    std::vector<Block> blocks;
+    while (r.cursor < r.end)
+    {
+        auto blockSize = r.value<uint64_t>();
+        auto block = r.bytes(blockSize);
+        BinaryReader b{block, block + blockSize};
+
+        auto &parsed = blocks.emplace_back();
+        parsed.entities.resize(b.count<uint32_t>(sizeof(Handle) + sizeof(uint8_t)));
+        for (auto &record : parsed.entities)
+        {
+            record.entity = b.value<Handle>();
+            record.alive = b.value<uint8_t>() != 0;
+        }
+        auto count = b.count<uint32_t>(sizeof(uint32_t) + sizeof(Handle) + sizeof(uint8_t) + sizeof(uint32_t));
+        for (uint32_t i = 0; i < count; i++)
+        {
+            ComponentRecord record;
+            record.type = ComponentType::find(b.string());
+            record.entity = b.value<Handle>();
+            readImage(b, record);
+            // Types unknown to this build are skipped.
+            if (!record.type)
+                continue;
+            if (record.present)
+            {
+                ScratchComponent scratch(*record.type);
+                BinaryReader image{record.bytes, record.bytes + record.size};
+                for (auto &field : record.type->fields)
+                    field.read(scratch.get(), image);
+            }
+            parsed.components.push_back(record);
+        }
+    }
+    for (auto &block : blocks)
+        applyRecords(registry, block.entities, block.components);
+    return true;
+}
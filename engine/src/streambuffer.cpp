@@ -0,0 +1,117 @@
+#include "streambuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Regions grow in steps of this many bytes, which also keeps every region and append() offset aligned, including
+// to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+const size_t STREAM_ALIGNMENT = 256;
+
+// Nanoseconds per glClientWaitSync call while waiting for a region to be released by the GPU.
+const GLuint64 STREAM_WAIT_TIMEOUT = 1000000;
+
+void StreamBuffer::reserve(GLenum target, size_t size)
+{
+    // Nothing is allocated for empty writes, glBufferStorage rejects a size of 0.
+    if ((buffer && size <= regionSize) || !size)
+    {
+        glBindBuffer(target, buffer);
+        return;
+    }
+    auto grown = std::max(regionSize * 2, (size + STREAM_ALIGNMENT - 1) / STREAM_ALIGNMENT * STREAM_ALIGNMENT);
+    destroy();
+    regionSize = grown;
+    auto total = GLsizeiptr(regionSize * STREAM_REGIONS);
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+#ifndef EMSCRIPTEN
+    if (GLEW_ARB_buffer_storage)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, total, nullptr, flags);
+        mapped = glMapBufferRange(target, 0, total, flags);
+        return;
+    }
+#endif // !EMSCRIPTEN
+    glBufferData(target, total, nullptr, GL_STREAM_DRAW);
+}
+
+size_t StreamBuffer::write(GLenum target, const void *data, size_t size)
+{
+    reserve(target, size);
+    nextRegion();
+    used = size;
+    auto offset = region * regionSize;
+    copy(target, offset, data, size);
+    return offset;
+}
+
+void StreamBuffer::nextRegion()
+{
+#ifndef EMSCRIPTEN
+    // Fenced when moving on, so the fence covers every draw issued since the region was written.
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif // !EMSCRIPTEN
+    region = (region + 1) % STREAM_REGIONS;
+    used = 0;
+#ifndef EMSCRIPTEN
+    if (auto fence = fences[region])
+    {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_WAIT_TIMEOUT) == GL_TIMEOUT_EXPIRED)
+            ;
+        glDeleteSync(fence);
+        fences[region] = nullptr;
+    }
+#endif // !EMSCRIPTEN
+}
+
+size_t StreamBuffer::append(GLenum target, const void *data, size_t size)
+{
+    auto start = (used + STREAM_ALIGNMENT - 1) / STREAM_ALIGNMENT * STREAM_ALIGNMENT;
+    auto full = !buffer || start + size > regionSize;
+    reserve(target, start + size);
+    if (full)
+        start = 0;
+    used = start + size;
+    auto offset = region * regionSize + start;
+    copy(target, offset, data, size);
+    return offset;
+}
+
+void StreamBuffer::copy(GLenum target, size_t offset, const void *data, size_t size)
+{
+    if (!size)
+        return;
+    if (mapped)
+    {
+        memcpy((char *)mapped + offset, data, size);
+        return;
+    }
+#ifdef EMSCRIPTEN
+    glBufferSubData(target, offset, size, data);
+#else
+    // The fence already guarantees the GPU is done with the region, the driver does not need to synchronize.
+    auto dst = glMapBufferRange(target, offset, size,
+                                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    memcpy(dst, data, size);
+    glUnmapBuffer(target);
+#endif // EMSCRIPTEN
+}
+
+void StreamBuffer::destroy()
+{
+    for (auto &fence : fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    // Deleting a mapped buffer unmaps it.
+    if (buffer)
+        glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    regionSize = 0;
+    region = 0;
+    used = 0;
+    mapped = nullptr;
+}
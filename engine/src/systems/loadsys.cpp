@@ -2,7 +2,11 @@
 
 #include "components/core.h"
 #include "engine.h"
+#include "jobsystem.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
 
 #include "loguru.hpp"
@@ -14,7 +18,43 @@
 #include "tiny_gltf.h"
 #include "components/transform.h"
 
+// Main thread time per frame spent creating the entities of finished imports.
+const auto IMPORT_FRAME_BUDGET = std::chrono::milliseconds(4);
+
+// Geometries of one glTF mesh, materials holds the glTF material index of each geometry, -1 for none.
+struct ImportedMesh
+{
+    std::vector<Geometry> geometries;
+    std::vector<int> materials;
+};
+
+// One glTF file being imported. The jobs parse the file and fill textures, materials and meshes, process() only
+// reads them once pending drops to zero and then creates the entities a few at a time, step counting the ones
+// created so far.
+struct GLTFImport
+{
+    std::string path;
+    uint64_t hash = 0;
+    std::atomic<int> pending{0};
+    std::atomic<int> finished{0};
+    std::atomic<int> total{1};
+    std::atomic<bool> failed{false};
+
+    tinygltf::Model model;
+    std::vector<Texture> textures;
+    // Material::textures holds indices into textures until the material is finalized.
+    std::vector<Material> materials;
+    std::vector<ImportedMesh> meshes;
+
+    size_t step = 0;
+    std::vector<Handle> textureHandles;
+    std::vector<Handle> materialHandles;
+    std::map<int, Handle> meshHandles;
+    Handle root = 0;
+};
+
 Handle instantiate(Registry *r, Handle source, Handle target);
+void destroyTree(Registry *r, Handle root);
 
 LoadSys::LoadSys()
 {
@@ -22,6 +62,9 @@ LoadSys::LoadSys()
 
 LoadSys::~LoadSys()
 {
+    // Jobs still running write into the imports.
+    for (auto &entry : imports)
+        JobSystem::instance()->wait(entry.second->pending);
 }
 
 void LoadSys::start()
@@ -30,29 +73,129 @@ void LoadSys::start()
 
 void LoadSys::process()
 {
-    syncResource<Ref, Instance>([&](Handle entity, Ref& ref) {
+    auto jobs = JobSystem::instance();
+    // Without workers nothing else would run the import jobs.
+    if (!jobs->workerCount())
+    {
+        while (jobs->runOne())
+            ;
+    }
+    auto deadline = std::chrono::steady_clock::now() + IMPORT_FRAME_BUDGET;
+
+    // Importing creates and copies lots of entities, so refs are only collected while iterating.
+    std::vector<Handle> pending;
+    r->each<Ref>([&](Handle entity, Ref &ref) {
+        if (!r->has<Instance>(entity))
+        {
+            pending.push_back(entity);
+        }
+    });
+    for (auto entity : pending)
+    {
+        auto ref = r->get<Ref>(entity);
         auto ext = std::filesystem::path(ref.path).extension().string();
         if (ext == ".gltf" || ext == ".glb")
         {
-            bool loaded = false;
-            Handle protoHandle = 0;
-            r->each<Proto>([&](Handle _handle, auto proto) {
-                if (proto.path == ref.path)
+            auto path = AssetCache::canonical(ref.path);
+            Handle protoHandle = assets.find(path);
+            if (!protoHandle)
+            {
+                auto &import = imports[path];
+                if (!import)
+                    import = startImport(path);
+                Loading loading;
+                if (import->failed)
                 {
-                    protoHandle = _handle;
-                    loaded = true;
+                    loading.state = Loading::Failed;
+                }
+                else if (import->pending)
+                {
+                    loading.state = import->finished ? Loading::Importing : Loading::Queued;
+                    loading.progress = float(import->finished) / float(import->total);
+                }
+                else
+                {
+                    loading.state = Loading::Finalizing;
+                    loading.progress = 1.0f;
+                    // A copy of a file already imported under another path reuses that proto.
+                    if (!import->step)
+                        protoHandle = assets.alias(path, import->hash);
+                    if (protoHandle)
+                    {
+                        import->root = protoHandle;
+                    }
+                    else if (std::chrono::steady_clock::now() < deadline)
+                    {
+                        protoHandle = finalize(*import, deadline);
+                        if (protoHandle)
+                        {
+                            assets.add(path, import->hash, protoHandle);
+                            r->addComponent(protoHandle, Proto{path});
+                        }
+                    }
+                }
+                if (!protoHandle)
+                {
+                    // Stays a placeholder until the proto exists.
+                    if (auto current = r->getPtr<Loading>(entity))
+                        *current = loading;
+                    else
+                        r->addComponent(entity, loading);
+                    continue;
                 }
-            });
-            if (!loaded)
-            {
-                protoHandle = loadGLTF(ref.path);
-                r->addComponent(protoHandle, Proto());
             }
+            if (r->has<Loading>(entity))
+                r->removeComponent<Loading>(entity);
             instantiate(r, protoHandle, entity);
             r->get<Info>(entity).name = "Instance:" + ref.path;
+            assets.acquire(protoHandle);
+            auto rel = r->read<Relation>(entity);
+            holders.push_back({entity, protoHandle, rel ? rel->children : std::vector<Handle>()});
         }
-        return Instance();
-    });
+        r->addComponent(entity, Instance());
+    }
+
+    // Failed imports are kept so their refs are not imported again every frame.
+    for (auto it = imports.begin(); it != imports.end();)
+    {
+        if (it->second->root)
+            it = imports.erase(it);
+        else
+            ++it;
+    }
+
+    releaseHolders();
+    for (auto proto : assets.collect())
+        destroyTree(r, proto);
+}
+
+void LoadSys::releaseHolders()
+{
+    for (size_t i = 0; i < holders.size();)
+    {
+        auto &holder = holders[i];
+        if (r->valid(holder.entity) && r->has<Ref>(holder.entity))
+        {
+            i++;
+            continue;
+        }
+        // Children moved to another parent since are left alone.
+        for (auto child : holder.children)
+        {
+            auto rel = r->valid(child) ? r->read<Relation>(child) : nullptr;
+            if (rel && rel->parent == holder.entity)
+                destroyTree(r, child);
+        }
+        if (auto rel = r->getPtr<Relation>(holder.entity))
+        {
+            auto &children = rel->children;
+            for (auto child : holder.children)
+                children.erase(std::remove(children.begin(), children.end(), child), children.end());
+        }
+        assets.release(holder.proto);
+        holders[i] = holders.back();
+        holders.pop_back();
+    }
 }
 
 Handle instantiate(Registry *r, Handle source, Handle target)
@@ -80,72 +223,172 @@ Handle instantiate(Registry *r, Handle source, Handle target)
     return target;
 }
 
-void openModel(std::string &fileName, tinygltf::Model &model);
-std::vector<Handle> importTextures(Registry *r, tinygltf::Model &model);
-std::vector<Handle> importMaterials(Registry *r, tinygltf::Model &model, std::vector<Handle> &textures);
-std::map<int, Handle> importMeshes(Registry *r, tinygltf::Model &model, std::vector<Handle> &materials);
+// Releases root and everything below it in the Relation hierarchy.
+void destroyTree(Registry *r, Handle root)
+{
+    if (auto rel = r->getPtr<Relation>(root))
+    {
+        for (auto child : rel->children)
+            destroyTree(r, child);
+    }
+    r->release(root);
+}
+
+bool openModel(const std::string &fileName, tinygltf::Model &model);
+Texture convertTexture(const tinygltf::Image &image);
+Material convertMaterial(tinygltf::Material &gmat);
+ImportedMesh convertMesh(tinygltf::Model &model, const tinygltf::Mesh &mesh);
 std::vector<Handle> importNodes(Registry *r, tinygltf::Model &model, std::map<int, Handle> &meshes);
 
 void addChildren(Registry *r, Handle parent, std::vector<Handle> &children)
 {
-    Relation &rel = r->get<Relation>(parent); 
+    r->get<Relation>(parent);
     for (auto child: children)
     {
+        // get() adds a Relation to children without one, which invalidates references to other Relations.
         auto &childRel = r->get<Relation>(child);
         if (!childRel.parent)
         {
             childRel.parent = parent;
-            rel.add(child);
+            r->get<Relation>(parent).add(child);
         }
     }
 }
 
-Handle LoadSys::loadGLTF(std::string path)
+// Runs job on the pool as part of import, a throwing job fails the whole import.
+void submitImportJob(GLTFImport *import, std::function<void()> job)
 {
-    tinygltf::Model model;
-    openModel(path, model);
-    int i = 0;
-    for (auto &node : model.nodes)
-    {
-        i++;
-        if (node.name.empty())
+    JobSystem::instance()->submit(
+        [import, job]() {
+            try
+            {
+                job();
+            }
+            catch (std::exception &e)
+            {
+                LOG_F(ERROR, "%s: %s", import->path.c_str(), e.what());
+                import->failed = true;
+            }
+            import->finished++;
+        },
+        &import->pending);
+}
+
+std::unique_ptr<GLTFImport> LoadSys::startImport(const std::string &path)
+{
+    auto import = std::make_unique<GLTFImport>();
+    import->path = path;
+    auto ptr = import.get();
+    submitImportJob(ptr, [ptr]() {
+        auto &model = ptr->model;
+        ptr->hash = AssetCache::hashFile(ptr->path);
+        if (!openModel(ptr->path, model))
         {
-            node.name = std::string("Node_") + std::to_string(i++);
+            ptr->failed = true;
+            return;
+        }
+        int i = 0;
+        for (auto &node : model.nodes)
+        {
+            i++;
+            if (node.name.empty())
+            {
+                node.name = std::string("Node_") + std::to_string(i++);
+            }
+        }
+        for (auto &gmat : model.materials)
+        {
+            ptr->materials.push_back(convertMaterial(gmat));
         }
-    }
 
-    auto textures = importTextures(r, model);
-    auto materials = importMaterials(r, model, textures);
-    auto meshMap = importMeshes(r, model, materials);    
-    auto nodes = importNodes(r, model, meshMap);
+        // Every texture and mesh converts on its own, the slots are sized up front so the jobs never reallocate.
+        ptr->textures.resize(model.textures.size());
+        ptr->meshes.resize(model.meshes.size());
+        ptr->total += int(model.textures.size() + model.meshes.size());
+        for (size_t t = 0; t < model.textures.size(); t++)
+        {
+            submitImportJob(ptr, [ptr, t]() {
+                auto &model = ptr->model;
+                ptr->textures[t] = convertTexture(model.images[model.textures[t].source]);
+            });
+        }
+        for (size_t m = 0; m < model.meshes.size(); m++)
+        {
+            submitImportJob(ptr, [ptr, m]() { ptr->meshes[m] = convertMesh(ptr->model, ptr->model.meshes[m]); });
+        }
+    });
+    return import;
+}
 
-    auto root = r->createEntity(Transform());    
-    auto rootRel = Relation();
-    for (auto node : nodes)
+Handle LoadSys::finalize(GLTFImport &import, std::chrono::steady_clock::time_point deadline)
+{
+    // At least one step per call, so an import always makes progress.
+    do
     {
-        auto& [rel] = r->getEntity<Relation>(node);
-        if (rel.parent == 0)
+        auto step = import.step++;
+        if (step < import.textures.size())
         {
-            rootRel.add(node);
-            rel.parent = root;
+            import.textureHandles.push_back(r->createEntity(import.textures[step]));
+            import.textures[step] = Texture();
+            continue;
+        }
+        step -= import.textures.size();
+        if (step < import.materials.size())
+        {
+            auto &material = import.materials[step];
+            for (auto &texture : material.textures)
+                texture = import.textureHandles[texture];
+            import.materialHandles.push_back(r->createEntity(material));
+            continue;
+        }
+        step -= import.materials.size();
+        if (step < import.meshes.size())
+        {
+            auto &mesh = import.meshes[step];
+            auto entity = r->createEntity(Mesh());
+            std::vector<Handle> geometries;
+            for (size_t g = 0; g < mesh.geometries.size(); g++)
+            {
+                auto &geo = mesh.geometries[g];
+                geo.material = mesh.materials[g] > -1 ? import.materialHandles[mesh.materials[g]] : 0;
+                geometries.push_back(r->createEntity(geo));
+            }
+            r->get<Mesh>(entity).geometries = geometries;
+            addChildren(r, entity, geometries);
+            import.meshHandles[int(step)] = entity;
+            mesh = ImportedMesh();
+            continue;
         }
-    }
-    r->addComponent(root, rootRel);
-    r->addComponent(root, Info{"Proto:" + path, false});
 
-    std::vector<Handle> meshes;
-    for (auto mv: meshMap)
-    {
-        meshes.push_back(mv.second);
-    }
-    addChildren(r, root, textures);
-    addChildren(r, root, materials);
-    addChildren(r, root, meshes);
+        auto nodes = importNodes(r, import.model, import.meshHandles);
+        auto root = r->createEntity(Transform());
+        auto rootRel = Relation();
+        for (auto node : nodes)
+        {
+            auto& [rel] = r->getEntity<Relation>(node);
+            if (rel.parent == 0)
+            {
+                rootRel.add(node);
+                rel.parent = root;
+            }
+        }
+        r->addComponent(root, rootRel);
+        r->addComponent(root, Info{"Proto:" + import.path, false});
 
-    return root;
+        std::vector<Handle> meshes;
+        for (auto mv: import.meshHandles)
+        {
+            meshes.push_back(mv.second);
+        }
+        addChildren(r, root, import.textureHandles);
+        addChildren(r, root, import.materialHandles);
+        addChildren(r, root, meshes);
+        import.root = root;
+    } while (!import.root && std::chrono::steady_clock::now() < deadline);
+    return import.root;
 }
 
-void openModel(std::string &fileName, tinygltf::Model &model)
+bool openModel(const std::string &fileName, tinygltf::Model &model)
 {
     tinygltf::TinyGLTF gltf_ctx;
     std::string err;
@@ -178,227 +421,201 @@ void openModel(std::string &fileName, tinygltf::Model &model)
     {
         LOG_F(ERROR, "Failed to parse glTF\n");
     }
+    return ret;
 }
 
-std::map<int, Handle> importMeshes(Registry* r, tinygltf::Model &model, std::vector<Handle> &materials)
+ImportedMesh convertMesh(tinygltf::Model &model, const tinygltf::Mesh &mesh)
 {
-    std::map<int, Handle> ret;
-
-    int i = 0;
-    for (auto mesh : model.meshes)
+    ImportedMesh ret;
+    for (auto primitive : mesh.primitives)
     {
-        auto entity = r->createEntity(Mesh());
-        Mesh &meshComp = r->get<Mesh>(entity);
-        ret[i++] = entity;
+        float *posBuffer = nullptr;
+        float *texBuffer = nullptr;
+        float *normBuffer = nullptr;
+        uint16_t *jointsBuffer = nullptr;
+        float *weightsBuffer = nullptr;
 
-        for (auto primitive : mesh.primitives)
-        {
-            float *posBuffer = nullptr;
-            float *texBuffer = nullptr;
-            float *normBuffer = nullptr;
-            uint16_t *jointsBuffer = nullptr;
-            float *weightsBuffer = nullptr;
-
-            size_t posStride = 3, normStride = 3, texStride = 2, jointsStride = 4, weightsStride = 4;
+        size_t posStride = 3, normStride = 3, texStride = 2, jointsStride = 4, weightsStride = 4;
 
-            if (!primitive.attributes.count("POSITION"))
-            {
-                throw std::runtime_error{"GLTF import error: positions are required"};
-            }
-            int pos = primitive.attributes["POSITION"];
-            auto posAcc = model.accessors[pos];
-            auto posView = model.bufferViews[posAcc.bufferView];
-            posBuffer = (float *)&model.buffers[posView.buffer].data[posAcc.byteOffset + posView.byteOffset];
-            posStride = posView.byteStride ? posView.byteStride / 4 : posStride;
-            int vertexCount = int(posAcc.count);
-
-            if (primitive.attributes.count("NORMAL"))
-            {
-                int norm = primitive.attributes["NORMAL"];
-                auto normAcc = model.accessors[norm];
-                auto normView = model.bufferViews[normAcc.bufferView];
-                normStride = normView.byteStride ? normView.byteStride / 4 : normStride;
-                normBuffer = (float *)&model.buffers[normView.buffer].data[normAcc.byteOffset + normView.byteOffset];
-            }
+        if (!primitive.attributes.count("POSITION"))
+        {
+            throw std::runtime_error{"GLTF import error: positions are required"};
+        }
+        int pos = primitive.attributes["POSITION"];
+        auto &posAcc = model.accessors[pos];
+        auto &posView = model.bufferViews[posAcc.bufferView];
+        posBuffer = (float *)&model.buffers[posView.buffer].data[posAcc.byteOffset + posView.byteOffset];
+        posStride = posView.byteStride ? posView.byteStride / 4 : posStride;
+        int vertexCount = int(posAcc.count);
+
+        if (primitive.attributes.count("NORMAL"))
+        {
+            int norm = primitive.attributes["NORMAL"];
+            auto &normAcc = model.accessors[norm];
+            auto &normView = model.bufferViews[normAcc.bufferView];
+            normStride = normView.byteStride ? normView.byteStride / 4 : normStride;
+            normBuffer = (float *)&model.buffers[normView.buffer].data[normAcc.byteOffset + normView.byteOffset];
+        }
 
-            if (primitive.attributes.count("JOINTS_0"))
-            {
-                auto acc = model.accessors[primitive.attributes["JOINTS_0"]];
-                auto view = model.bufferViews[acc.bufferView];
-                jointsStride = view.byteStride ? view.byteStride / sizeof(uint16_t)
-                                               : (tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC4));
-                jointsBuffer = (uint16_t *)&model.buffers[view.buffer].data[acc.byteOffset + view.byteOffset];
-            }
+        if (primitive.attributes.count("JOINTS_0"))
+        {
+            auto &acc = model.accessors[primitive.attributes["JOINTS_0"]];
+            auto &view = model.bufferViews[acc.bufferView];
+            jointsStride = view.byteStride ? view.byteStride / sizeof(uint16_t)
+                                           : (tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC4));
+            jointsBuffer = (uint16_t *)&model.buffers[view.buffer].data[acc.byteOffset + view.byteOffset];
+        }
 
-            if (primitive.attributes.count("WEIGHTS_0"))
-            {
-                auto acc = model.accessors[primitive.attributes["WEIGHTS_0"]];
-                auto view = model.bufferViews[acc.bufferView];
-                weightsStride = view.byteStride ? view.byteStride / sizeof(float)
-                                                : (tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC4));
-                weightsBuffer = (float *)&model.buffers[view.buffer].data[acc.byteOffset + view.byteOffset];
-            }
+        if (primitive.attributes.count("WEIGHTS_0"))
+        {
+            auto &acc = model.accessors[primitive.attributes["WEIGHTS_0"]];
+            auto &view = model.bufferViews[acc.bufferView];
+            weightsStride = view.byteStride ? view.byteStride / sizeof(float)
+                                            : (tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC4));
+            weightsBuffer = (float *)&model.buffers[view.buffer].data[acc.byteOffset + view.byteOffset];
+        }
 
-            if (primitive.attributes.count("TEXCOORD_0"))
-            {
-                int tex = primitive.attributes["TEXCOORD_0"];
-                auto texAcc = model.accessors[tex];
-                auto texView = model.bufferViews[texAcc.bufferView];
-                texStride = texView.byteStride ? texView.byteStride / 4 : texStride;
-                texBuffer = (float *)&model.buffers[texView.buffer].data[texAcc.byteOffset + texView.byteOffset];
-            }
+        if (primitive.attributes.count("TEXCOORD_0"))
+        {
+            int tex = primitive.attributes["TEXCOORD_0"];
+            auto &texAcc = model.accessors[tex];
+            auto &texView = model.bufferViews[texAcc.bufferView];
+            texStride = texView.byteStride ? texView.byteStride / 4 : texStride;
+            texBuffer = (float *)&model.buffers[texView.buffer].data[texAcc.byteOffset + texView.byteOffset];
+        }
 
-            std::vector<uint32_t> indices;
-            if (primitive.indices > -1)
-            {
-                auto indexAcc = model.accessors[primitive.indices];
-                auto indexView = model.bufferViews[indexAcc.bufferView];
-                auto indexBuffer = model.buffers[indexView.buffer];
-                auto data = &indexBuffer.data[indexAcc.byteOffset + indexView.byteOffset];
-                for (int i = 0; i < indexAcc.count; i++)
-                {
-                    switch (indexAcc.componentType)
-                    {
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
-                        indices.push_back(((uint32_t *)data)[i]);
-                        break;
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
-                        indices.push_back(((uint16_t *)data)[i]);
-                        break;
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
-                        indices.push_back(((uint8_t *)data)[i]);
-                        break;
-                    }
-                }
-            }
-            Geometry geo;
-            geo.vertices.resize(vertexCount);
-            //             if (jointsBuffer)
-            //             {
-            //                 mesh->skinBuffer.vertices.resize(vertexCount);
-            //             }
-            for (int i = 0; i < vertexCount; i++)
+        std::vector<uint32_t> indices;
+        if (primitive.indices > -1)
+        {
+            auto &indexAcc = model.accessors[primitive.indices];
+            auto &indexView = model.bufferViews[indexAcc.bufferView];
+            auto &indexBuffer = model.buffers[indexView.buffer];
+            auto data = &indexBuffer.data[indexAcc.byteOffset + indexView.byteOffset];
+            indices.resize(indexAcc.count);
+            for (size_t i = 0; i < indexAcc.count; i++)
             {
-                Vertex vert;
-                vert.color = Color::white;
-                vert.pos = glm::make_vec3(&posBuffer[i * posStride]);
-                if (normBuffer)
-                {
-                    vert.normal = glm::make_vec3(&normBuffer[i * normStride]);
-                }
-                if (texBuffer)
+                switch (indexAcc.componentType)
                 {
-                    vert.uv = glm::make_vec2(&texBuffer[i * texStride]);
+                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+                    indices[i] = ((uint32_t *)data)[i];
+                    break;
+                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+                    indices[i] = ((uint16_t *)data)[i];
+                    break;
+                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
+                    indices[i] = ((uint8_t *)data)[i];
+                    break;
                 }
-                //                 if (jointsBuffer)
-                //                 {
-                //                     mesh->skinBuffer.vertices[i].weights = glm::make_vec4(&weightsBuffer[i *
-                //                     weightsStride]); mesh->skinBuffer.vertices[i].bones.x = jointsBuffer[i *
-                //                     jointsStride + 0]; mesh->skinBuffer.vertices[i].bones.y = jointsBuffer[i *
-                //                     jointsStride + 1]; mesh->skinBuffer.vertices[i].bones.z = jointsBuffer[i *
-                //                     jointsStride + 2]; mesh->skinBuffer.vertices[i].bones.w = jointsBuffer[i *
-                //                     jointsStride + 3];
-                //                 }
-                geo.vertices[i] = vert;
             }
-            if (indices.size())
-            {
-                geo.indices = indices;
-            }
-            if (primitive.material > -1)
+        }
+        Geometry geo;
+        geo.vertices.resize(vertexCount);
+        //             if (jointsBuffer)
+        //             {
+        //                 mesh->skinBuffer.vertices.resize(vertexCount);
+        //             }
+        for (int i = 0; i < vertexCount; i++)
+        {
+            Vertex vert;
+            vert.color = Color::white;
+            vert.pos = glm::make_vec3(&posBuffer[i * posStride]);
+            if (normBuffer)
             {
-                geo.material = materials[primitive.material];
+                vert.normal = glm::make_vec3(&normBuffer[i * normStride]);
             }
-            else
+            if (texBuffer)
             {
-                geo.material = 0;
+                vert.uv = glm::make_vec2(&texBuffer[i * texStride]);
             }
-            geo.updateBBox();
-            auto geoEntity = r->createEntity(geo);
-            meshComp.geometries.push_back(geoEntity);
-            auto children = std::vector<Handle>{geoEntity};
-            addChildren(r, entity, children);
+            //                 if (jointsBuffer)
+            //                 {
+            //                     mesh->skinBuffer.vertices[i].weights = glm::make_vec4(&weightsBuffer[i *
+            //                     weightsStride]); mesh->skinBuffer.vertices[i].bones.x = jointsBuffer[i *
+            //                     jointsStride + 0]; mesh->skinBuffer.vertices[i].bones.y = jointsBuffer[i *
+            //                     jointsStride + 1]; mesh->skinBuffer.vertices[i].bones.z = jointsBuffer[i *
+            //                     jointsStride + 2]; mesh->skinBuffer.vertices[i].bones.w = jointsBuffer[i *
+            //                     jointsStride + 3];
+            //                 }
+            geo.vertices[i] = vert;
         }
-
-        LOG_F(INFO, "Imported %d primitives", mesh.primitives.size());
+        if (indices.size())
+        {
+            geo.indices = std::move(indices);
+        }
+        geo.updateBBox();
+        ret.geometries.push_back(std::move(geo));
+        ret.materials.push_back(primitive.material);
     }
+
+    LOG_F(INFO, "Imported %d primitives", int(mesh.primitives.size()));
     return ret;
 }
 
-std::vector<Handle> importTextures(Registry *r, tinygltf::Model &model)
+Texture convertTexture(const tinygltf::Image &image)
 {
-    std::vector<Handle> ret;
-    for (auto tex : model.textures)
+    auto texture = Texture{ivec2(image.width, image.height)};
+    if (image.component == 3)
     {
-        auto image = model.images[tex.source];
-        auto texture = Texture{ivec2(image.width, image.height)};
-        if (image.component == 3)
+        texture.pixels.resize(size_t(image.width) * image.height * 4);
+        auto src = image.image.data();
+        auto dst = texture.pixels.data();
+        for (size_t i = 0, count = image.image.size() / 3; i < count; i++, src += 3, dst += 4)
         {
-            texture.pixels.resize(image.width * image.height * 4);
-            for (int i = 0; i < image.image.size() / 3; i++)
-            {
-                texture.pixels[i * 4 + 0] = image.image[i * 3 + 0];
-                texture.pixels[i * 4 + 1] = image.image[i * 3 + 1];
-                texture.pixels[i * 4 + 2] = image.image[i * 3 + 2];
-                texture.pixels[i * 4 + 3] = 255;
-            }
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+            dst[3] = 255;
         }
-        else if (image.component == 4)
-        {
-            texture.pixels = image.image;
-        }
-        else
-        {
-            throw std::runtime_error("GLTF Import Error: unsupported texture type");
-        }
-        ret.push_back(r->createEntity(texture));
-    }    
-    return ret;
+    }
+    else if (image.component == 4)
+    {
+        texture.pixels = image.image;
+    }
+    else
+    {
+        throw std::runtime_error("GLTF Import Error: unsupported texture type");
+    }
+    return texture;
 }
 
-std::vector<Handle> importMaterials(Registry *r, tinygltf::Model &model, std::vector<Handle> &textures)
+Material convertMaterial(tinygltf::Material &gmat)
 {
-    auto ret = std::vector<Handle>();
-    for (auto gmat : model.materials)
+    Material material;
+    material.diffuseColor = vec4(1.0);
+    if (gmat.pbrMetallicRoughness.metallicRoughnessTexture.index == -1)
+        material.type = Material::Simple;
+    else
+        material.type = Material::PBR;
+    if (gmat.values.count("baseColorTexture"))
     {
-        Material material;
-        material.diffuseColor = vec4(1.0);
-        if (gmat.pbrMetallicRoughness.metallicRoughnessTexture.index == -1)
-            material.type = Material::Simple;
-        else
-            material.type = Material::PBR;
-        if (gmat.values.count("baseColorTexture"))
-        {
-            material.textures.push_back(textures[gmat.values["baseColorTexture"].TextureIndex()]);
-            LOG_F(INFO, "Loaded texture: baseColorTexture");
-        }
-        if (gmat.normalTexture.index > -1)
-        {
-            material.textures.push_back(textures[gmat.normalTexture.index]);
-            LOG_F(INFO, "Loaded texture: normalTexture");
-        }
-        if (gmat.pbrMetallicRoughness.metallicRoughnessTexture.index > -1)
-        {
-            material.textures.push_back(textures[gmat.pbrMetallicRoughness.metallicRoughnessTexture.index]);
-            LOG_F(INFO, "Loaded texture: pbrMetallicRoughness");
-        }
-        if (gmat.occlusionTexture.index > -1)
-        {
-            material.textures.push_back(textures[gmat.occlusionTexture.index]);
-            LOG_F(INFO, "Loaded texture: occlusionTexture");
-        }
-        if (gmat.emissiveTexture.index > -1)
-        {
-            material.textures.push_back(textures[gmat.emissiveTexture.index]);
-            LOG_F(INFO, "Loaded texture: emissiveTexture");
-        }
-        if (gmat.values.count("baseColorFactor"))
-        {
-            material.diffuseColor = glm::make_vec4(gmat.values["baseColorFactor"].ColorFactor().data());
-        }
-        ret.push_back(r->createEntity(material));
+        material.textures.push_back(gmat.values["baseColorTexture"].TextureIndex());
+        LOG_F(INFO, "Loaded texture: baseColorTexture");
     }
-    return ret;
+    if (gmat.normalTexture.index > -1)
+    {
+        material.textures.push_back(gmat.normalTexture.index);
+        LOG_F(INFO, "Loaded texture: normalTexture");
+    }
+    if (gmat.pbrMetallicRoughness.metallicRoughnessTexture.index > -1)
+    {
+        material.textures.push_back(gmat.pbrMetallicRoughness.metallicRoughnessTexture.index);
+        LOG_F(INFO, "Loaded texture: pbrMetallicRoughness");
+    }
+    if (gmat.occlusionTexture.index > -1)
+    {
+        material.textures.push_back(gmat.occlusionTexture.index);
+        LOG_F(INFO, "Loaded texture: occlusionTexture");
+    }
+    if (gmat.emissiveTexture.index > -1)
+    {
+        material.textures.push_back(gmat.emissiveTexture.index);
+        LOG_F(INFO, "Loaded texture: emissiveTexture");
+    }
+    if (gmat.values.count("baseColorFactor"))
+    {
+        material.diffuseColor = glm::make_vec4(gmat.values["baseColorFactor"].ColorFactor().data());
+    }
+    return material;
 }
 
 std::vector<Handle> importNodes(Registry *r, tinygltf::Model &model, std::map<int, Handle> &meshes)
@@ -15,6 +15,8 @@ const char *RenderDescriptorTypeNames[] = {
     "model", "view", "projection", "diffuseColor", "baseColorTexture", "ssaoKernel", "ssaoNoiseTexture", "mapColor", "mapNormal", "mapDepth", "mapPosition", "mapSSAO", 0,
 };
 
+const char *UniformBlockNames[] = {"Camera", "Pass", "Draw"};
+
 RenderSys *RenderSys::_instance = nullptr;
 Handle quadHandle, ssaoNoiseTextureHandle;
 std::vector<glm::vec3> ssaoKernel;
@@ -26,44 +28,101 @@ void GLAPIENTRY MessageCallback(GLenum source, GLenum type, GLuint id, GLenum se
           (type == GL_DEBUG_TYPE_ERROR ? "** GL ERROR **" : ""), type, severity, message);
 }
 
-void RenderSys::bindMaterial(const Geometry &geo, const GLPipeline &pipeline)
+// Per segment attributes of the lines variants, after the quad corner at location 0.
+const GLuint DEBUG_START_LOCATION = 4;
+const GLuint DEBUG_END_LOCATION = 5;
+const GLuint DEBUG_COLOR_LOCATION = 6;
+
+// Smallest run of draws sharing a geometry worth an instanced draw.
+const size_t MIN_INSTANCES = 2;
+
+// Nothing bound yet, unlike 0 which stands for the default white material.
+const Handle UNBOUND_MATERIAL = ~Handle(0);
+
+void RenderSys::resetState()
+{
+    boundMaterial = UNBOUND_MATERIAL;
+    boundVao = GLuint(-1);
+}
+
+void RenderSys::bindMaterial(const Geometry &geo, const short *uniforms)
 {
+    if (geo.material == boundMaterial)
+        return;
+    boundMaterial = geo.material;
     if (geo.material)
     {
-        auto &[mat] = r->getEntity<Material>(geo.material);
-        glUniform4fv(pipeline.uniforms[RenderDescriptorType::MATERIAL_DIFFUSE], 1,
-                     glm::value_ptr((vec4)mat.diffuseColor));
+        auto &[mat] = r->readEntity<Material>(geo.material);
         for (size_t i = 0; i < mat.textures.size(); i++)
         {
-            auto &[tex] = r->getEntity<GLTexture>(mat.textures[i]);
+            auto &[tex] = r->readEntity<GLTexture>(mat.textures[i]);
             glActiveTexture(GL_TEXTURE0 + i);
             glBindTexture(GL_TEXTURE_2D, tex.textureName);
-            glUniform1i(pipeline.uniforms[RenderDescriptorType::MATERIAL_BASE_COLOR_TEXTURE], i);
+            glUniform1i(uniforms[RenderDescriptorType::MATERIAL_BASE_COLOR_TEXTURE], i);
+            stats.binds++;
+            stats.uniforms++;
         }
     }
     else
     {
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, 0);
-        glUniform4fv(pipeline.uniforms[RenderDescriptorType::MATERIAL_DIFFUSE], 1, glm::value_ptr(vec4(1.0)));
+        stats.binds++;
+    }
+}
+
+void RenderSys::pushDraw(const mat4 &model, Handle material)
+{
+    // Draws are sorted by material, the color is only looked up when it changes.
+    if (material != drawMaterial)
+    {
+        drawMaterial = material;
+        drawColor = vec4(1.0);
+        if (material)
+        {
+            auto &[mat] = r->readEntity<Material>(material);
+            drawColor = mat.diffuseColor;
+        }
+    }
+    auto offset = drawData.size();
+    drawData.resize(offset + drawStride);
+    DrawBlock block{model, drawColor};
+    memcpy(drawData.data() + offset, &block, sizeof(block));
+}
+
+void RenderSys::bindDraw(size_t index)
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_BLOCK, drawStream.buffer, drawOffset + index * drawStride,
+                      sizeof(DrawBlock));
+    stats.binds++;
+}
+
+void RenderSys::bindVertexArray(GLuint vao)
+{
+    if (vao != boundVao)
+    {
+        glBindVertexArray(vao);
+        boundVao = vao;
+        stats.binds++;
     }
 }
 
 void RenderSys::drawGeometry(const GLPipeline &pipeline, const GLGeometry &ggeo)
 {
-    glBindVertexArray(ggeo.vao);
+    bindVertexArray(ggeo.vao);
     if (ggeo.useIndex)
     {
-        glDrawElements(ggeo.type,       // mode
-                       ggeo.count,      // count
-                       GL_UNSIGNED_INT, // type
-                       (void *)0        // element array buffer offset
+        glDrawElements(ggeo.type,                 // mode
+                       ggeo.count,                // count
+                       GL_UNSIGNED_INT,           // type
+                       (void *)ggeo.indexOffset   // element array buffer offset
         );
     }
     else
     {
         glDrawArrays(ggeo.type, 0, ggeo.count);
     }
+    stats.draws++;
 }
 
 void RenderSys::renderToTarget(GLFrameBuffer &target, GLPipeline& pipeline, Camera &camera,
@@ -74,11 +133,9 @@ void RenderSys::renderToTarget(GLFrameBuffer &target, GLPipeline& pipeline, Came
     glClearColor(0.010f, 0.050f, 0.070f, 1.000f);
     glClear(target.clearMask);
     
+    resetState();
     glUseProgram(pipeline.programName);
-    glUniformMatrix4fv(pipeline.uniforms[RenderDescriptorType::TRANSFORM_VIEW], 1, GL_FALSE,
-                       glm::value_ptr(camera.view));
-    glUniformMatrix4fv(pipeline.uniforms[RenderDescriptorType::TRANSFORM_PROJECTION], 1, GL_FALSE,
-                       glm::value_ptr(camera.projection));
+    stats.binds++;
 
 
     int i = 2;
@@ -90,6 +147,8 @@ void RenderSys::renderToTarget(GLFrameBuffer &target, GLPipeline& pipeline, Came
             glActiveTexture(GL_TEXTURE0 + i);
             glBindTexture(GL_TEXTURE_2D, attachment.texture.textureName);
             glUniform1i(pipeline.uniforms[attachment.info.name], i);             
+            stats.binds++;
+            stats.uniforms++;
         }
     }    
 
@@ -104,41 +163,88 @@ void RenderSys::renderToTarget(GLFrameBuffer &target, GLPipeline& pipeline, Came
                 i++;
                 glActiveTexture(GL_TEXTURE0 + i);
                 glBindTexture(GL_TEXTURE_2D, tex.textureName);
-                auto loc = glGetUniformLocation(pipeline.programName, "ssaoNoiseTexture");
-                glUniform1i(loc, i);
+                glUniform1i(pipeline.uniforms[RenderDescriptorType::SSAO_NOISE_TEXTURE], i);
+                stats.binds++;
+                stats.uniforms++;
             }
-            glUniform3fv(glGetUniformLocation(pipeline.programName, "ssaoKernel"), ssaoKernel.size(), (GLfloat*)ssaoKernel.data());
             drawGeometry(pipeline, ggeo);
         }
     }
     else
     {
-        r->each<Transform, Geometry, GLGeometry>(
-            [&](int entity, Transform &transform, Geometry &geo, GLGeometry &ggeo) {
-                auto inf = r->getPtr<Info>(entity);
-                if (!(geo.layer & pipeline.info.layers) || (inf && !inf->active))
-                    return;
-                glUniformMatrix4fv(pipeline.uniforms[RenderDescriptorType::TRANSFORM_MODEL], 1, GL_FALSE,
-                                   glm::value_ptr(transform.worldMatrix()));
-                bindMaterial(geo, pipeline);
-                drawGeometry(pipeline, ggeo);
-            });
-
-        r->each<Transform, Renderable>(
-            [&](int entity, Transform &transform, Renderable& renderable) {
-                auto inf = r->getPtr<Info>(entity);
-                if (!(renderable.layer & pipeline.info.layers) || (inf && !inf->active))
-                    return;
-                glUniformMatrix4fv(pipeline.uniforms[RenderDescriptorType::TRANSFORM_MODEL], 1, GL_FALSE,
-                                   glm::value_ptr(transform.worldMatrix()));
-                auto &[mesh] = r->getEntity<Mesh>(renderable.handle);
-                for (auto geoHandle : mesh.geometries)
-                {
-                    auto &[geo, ggeo] = r->getEntity<Geometry, GLGeometry>(geoHandle);
-                    bindMaterial(geo, pipeline);
-                    drawGeometry(pipeline, ggeo);
-                }
-            });
+        // Depth is the distance along the view direction, sorting on it draws front to back within a state group.
+        auto depth = [&](const mat4 &world) { return -(camera.view * world[3]).z; };
+        drawList.clear();
+        for (auto entity : visibleGeometries)
+        {
+            auto &[transform, geo, ggeo] = r->readEntity<Transform, Geometry, GLGeometry>(entity);
+            auto inf = r->read<Info>(entity);
+            if (!(geo.layer & pipeline.info.layers) || (inf && !inf->active))
+                continue;
+            auto &world = transform.worldMatrix();
+            drawList.push(DrawList::makeKey(pipeline.programName, geo.material, ggeo.vao, depth(world)), &world, &geo,
+                          &ggeo);
+        }
+
+        for (auto entity : visibleRenderables)
+        {
+            auto &[transform, renderable] = r->readEntity<Transform, Renderable>(entity);
+            auto inf = r->read<Info>(entity);
+            if (!(renderable.layer & pipeline.info.layers) || (inf && !inf->active))
+                continue;
+            auto &world = transform.worldMatrix();
+            auto &[mesh] = r->readEntity<Mesh>(renderable.handle);
+            for (auto geoHandle : mesh.geometries)
+            {
+                auto &[geo, ggeo] = r->readEntity<Geometry, GLGeometry>(geoHandle);
+                drawList.push(DrawList::makeKey(pipeline.programName, geo.material, ggeo.vao, depth(world)), &world,
+                              &geo, &ggeo);
+            }
+        }
+
+        drawList.sort();
+        // Runs of one geometry are left for drawInstanced() when the pipeline has an instanced variant, everything
+        // else is drawn one by one first so the program switches at most once.
+        auto &items = drawList.items;
+        runs.clear();
+        instances.clear();
+        singles.clear();
+        for (size_t begin = 0, end; begin < items.size(); begin = end)
+        {
+            for (end = begin + 1; end < items.size() && items[end].glGeometry == items[begin].glGeometry; end++)
+                ;
+            if (pipeline.instancedProgramName && end - begin >= MIN_INSTANCES)
+            {
+                runs.push_back({begin, end, instances.size()});
+                for (auto k = begin; k < end; k++)
+                    instances.push_back(*items[k].model);
+                continue;
+            }
+            for (auto k = begin; k < end; k++)
+                singles.push_back(k);
+        }
+
+        // Every DrawBlock of the subpass is uploaded at once, the draws then only bind their range.
+        drawData.clear();
+        drawMaterial = UNBOUND_MATERIAL;
+        for (auto k : singles)
+            pushDraw(*items[k].model, items[k].geometry->material);
+        for (auto &run : runs)
+            pushDraw(glm::identity<mat4>(), items[run.begin].geometry->material);
+        pushDraw(glm::identity<mat4>(), 0);
+        drawOffset = drawStream.append(GL_UNIFORM_BUFFER, drawData.data(), drawData.size());
+
+        for (size_t k = 0; k < singles.size(); k++)
+        {
+            auto &item = items[singles[k]];
+            bindDraw(k);
+            bindMaterial(*item.geometry, pipeline.uniforms);
+            drawGeometry(pipeline, *item.glGeometry);
+        }
+        if (!runs.empty())
+            drawInstanced(pipeline, attachments);
+        if (pipeline.linesProgramName && !debugRuns.empty())
+            drawDebugLines(pipeline);
     }
     //     if (target.multisampled)
 //     {
@@ -157,8 +263,138 @@ void RenderSys::renderToTarget(GLFrameBuffer &target, GLPipeline& pipeline, Came
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+void RenderSys::drawInstanced(const GLPipeline &pipeline, std::vector<GLAttachment> &attachments)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(mat4), instances.data(), GL_STREAM_DRAW);
+
+    // Samplers belong to the program, the textures bound by renderToTarget stay on the same units. The uniform
+    // blocks are bound to the context and shared with the main program.
+    auto uniforms = pipeline.instancedUniforms;
+    glUseProgram(pipeline.instancedProgramName);
+    stats.binds += 2;
+    int unit = 2;
+    for (auto &attachment : attachments)
+    {
+        if (pipeline.uniforms[attachment.info.name] > -1)
+        {
+            unit++;
+            glUniform1i(uniforms[attachment.info.name], unit);
+            stats.uniforms++;
+        }
+    }
+    boundMaterial = UNBOUND_MATERIAL;
+
+    for (size_t k = 0; k < runs.size(); k++)
+    {
+        auto &run = runs[k];
+        auto &item = drawList.items[run.begin];
+        auto &ggeo = *item.glGeometry;
+        auto count = GLsizei(run.end - run.begin);
+        bindDraw(singles.size() + k);
+        bindMaterial(*item.geometry, uniforms);
+        bindVertexArray(ggeo.vao);
+        for (GLuint c = 0; c < 4; c++)
+        {
+            glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + c);
+            glVertexAttribPointer(INSTANCE_MODEL_LOCATION + c, 4, GL_FLOAT, GL_FALSE, sizeof(mat4),
+                                  (void *)(run.offset * sizeof(mat4) + c * sizeof(vec4)));
+            glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + c, 1);
+        }
+        if (ggeo.useIndex)
+            glDrawElementsInstanced(ggeo.type, ggeo.count, GL_UNSIGNED_INT, (void *)ggeo.indexOffset, count);
+        else
+            glDrawArraysInstanced(ggeo.type, 0, ggeo.count, count);
+        stats.draws++;
+        // The VAO is the one the geometry is drawn with one by one too, which must not read the instance buffer.
+        for (GLuint c = 0; c < 4; c++)
+        {
+            glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + c, 0);
+            glDisableVertexAttribArray(INSTANCE_MODEL_LOCATION + c);
+        }
+    }
+}
+
+void RenderSys::uploadDebugLines()
+{
+    debugSegments.clear();
+    debugRuns.clear();
+    for (auto &layer : DebugDraw::of(r)->layers())
+    {
+        if (layer.segments.empty())
+            continue;
+        debugRuns.push_back({layer.mask, debugSegments.size(), layer.segments.size()});
+        debugSegments.insert(debugSegments.end(), layer.segments.begin(), layer.segments.end());
+    }
+    if (!debugSegments.empty())
+    {
+        debugOffset = debugStream.write(GL_ARRAY_BUFFER, debugSegments.data(),
+                                        debugSegments.size() * sizeof(DebugDraw::Segment));
+    }
+}
+
+void RenderSys::drawDebugLines(const GLPipeline &pipeline)
+{
+    glUseProgram(pipeline.linesProgramName);
+    bindDraw(singles.size() + runs.size());
+    boundMaterial = UNBOUND_MATERIAL;
+    bindVertexArray(debugVao);
+    glBindBuffer(GL_ARRAY_BUFFER, debugStream.buffer);
+    stats.binds += 2;
+
+    for (auto &run : debugRuns)
+    {
+        if (!(run.mask & pipeline.info.layers))
+            continue;
+        auto offset = debugOffset + run.first * sizeof(DebugDraw::Segment);
+        auto stride = sizeof(DebugDraw::Segment);
+        glVertexAttribPointer(DEBUG_START_LOCATION, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void *)(offset + offsetof(DebugDraw::Segment, a)));
+        glVertexAttribPointer(DEBUG_END_LOCATION, 3, GL_FLOAT, GL_FALSE, stride,
+                              (void *)(offset + offsetof(DebugDraw::Segment, b)));
+        glVertexAttribPointer(DEBUG_COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void *)(offset + offsetof(DebugDraw::Segment, color)));
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(run.count));
+        stats.draws++;
+    }
+}
+
+void RenderSys::cull(Camera &camera)
+{
+    Frustum frustum(camera.projection * camera.view);
+    bounds.clear();
+    candidates.clear();
+    r->readEach<Transform, Geometry, GLGeometry>(
+        [&](Handle entity, const Transform &transform, const Geometry &geo, const GLGeometry &) {
+            bounds.push(transform.worldMatrix() * geo.bbox);
+            candidates.push_back(entity);
+        });
+    auto geometries = candidates.size();
+    r->readEach<Transform, Renderable>([&](Handle entity, const Transform &transform, const Renderable &) {
+        // Renderables without a BBox are never culled.
+        auto box = r->read<BBox>(entity);
+        bounds.push(box ? transform.worldMatrix() * *box : BBox());
+        candidates.push_back(entity);
+    });
+    bounds.cull(frustum, visible);
+
+    visibleGeometries.clear();
+    visibleRenderables.clear();
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        if (visible[i])
+            (i < geometries ? visibleGeometries : visibleRenderables).push_back(candidates[i]);
+    }
+}
+
 void RenderSys::renderPass(RenderPassInstance &pass, Camera &camera)
 {    
+    cull(camera);
+    CameraBlock block{camera.view, camera.projection};
+    auto offset = cameraStream.append(GL_UNIFORM_BUFFER, &block, sizeof(block));
+    glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK, cameraStream.buffer, offset, sizeof(block));
+    glBindBufferBase(GL_UNIFORM_BUFFER, PASS_BLOCK, passBuffer);
+    stats.binds += 2;
     for (size_t i = 0; i < pass.subpasses.size(); i++)
     {
         renderToTarget(pass.subpasses[i].glFrameBuffer, pass.subpasses[i].glPipeline, camera, pass.attachments);
@@ -167,8 +403,9 @@ void RenderSys::renderPass(RenderPassInstance &pass, Camera &camera)
 
 RenderSys::RenderSys()
 {
-
-
+    // Passes and cameras are walked through each(), the rest is only read.
+    writes<RenderPassInstance, Camera>();
+    reads<Transform, Geometry, GLGeometry, Renderable, Mesh, Material, GLTexture, Info>();
 }
 
 RenderSys::~RenderSys()
@@ -218,6 +455,34 @@ void RenderSys::start()
     glEnable(GL_DEBUG_OUTPUT);
     glDebugMessageCallback(MessageCallback, 0);
 #endif // !EMSCRIPTEN
+    glGenBuffers(1, &instanceBuffer);
+
+    PassBlock passBlock = {};
+    for (size_t i = 0; i < ssaoKernel.size(); i++)
+        passBlock.ssaoKernel[i] = vec4(ssaoKernel[i], 0.0f);
+    glGenBuffers(1, &passBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, passBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(passBlock), &passBlock, GL_STATIC_DRAW);
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = std::max(alignment, 1);
+    drawStride = (sizeof(DrawBlock) + alignment - 1) / alignment * alignment;
+
+    // Quad every debug segment is expanded to, x runs along the segment and y across it.
+    const float corners[] = {0, -1, 0, 1, 1, -1, 1, 1};
+    glGenVertexArrays(1, &debugVao);
+    glBindVertexArray(debugVao);
+    glGenBuffers(1, &debugQuad);
+    glBindBuffer(GL_ARRAY_BUFFER, debugQuad);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+    glEnableVertexAttribArray(0);
+    for (auto location : {DEBUG_START_LOCATION, DEBUG_END_LOCATION, DEBUG_COLOR_LOCATION})
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    glBindVertexArray(0);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_DEPTH_TEST);
@@ -229,8 +494,13 @@ void RenderSys::start()
 
 void RenderSys::process()
 {
+    stats = RenderStats();
+    cameraStream.nextRegion();
+    drawStream.nextRegion();
+    uploadDebugLines();
     r->each<RenderPassInstance, Camera>(
-        [&](int entity, auto &pass, auto &camera) { renderPass(pass, camera); });
+        [&](Handle entity, auto &pass, auto &camera) { renderPass(pass, camera); });
+    DebugDraw::of(r)->clear();
 }
 
 void *RenderSys::uiRenderTargetHandle(Handle entity)
@@ -307,10 +307,36 @@ RenderDescriptorType toRenderDescType(std::string name)
     return UNKNOWN_TYPE;
 }
 
+// Links an optional <fileName>.<variant>.vert with the fragment shader of the pipeline, 0 when there is none.
+GLuint linkVariant(const std::string &fileName, const std::string &variant)
+{
+    auto vertexFile = fileName + "." + variant + ".vert";
+    if (ResourceSys::absPath(vertexFile).empty())
+        return 0;
+    auto vertex = compileShader(vertexFile, GL_VERTEX_SHADER);
+    auto fragment = compileShader(fileName + ".frag", GL_FRAGMENT_SHADER);
+    if (vertex && fragment)
+    {
+        return linkProgram(vertex, fragment);
+    }
+    return 0;
+}
+
+// Points the blocks a program declares at the shared binding points, blocks the program does not use are skipped.
+void bindUniformBlocks(GLuint programName)
+{
+    for (GLuint binding = 0; binding < UNIFORM_BLOCK_COUNT; binding++)
+    {
+        auto index = glGetUniformBlockIndex(programName, UniformBlockNames[binding]);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(programName, index, binding);
+    }
+}
+
 GLPipeline ResourceSys::createPipeline(Pipeline info)
 {
     GLPipeline *gp = 0;
-    r->each<Pipeline, GLPipeline>([&](int id, Pipeline &pipe, GLPipeline &gpipe) {
+    r->each<Pipeline, GLPipeline>([&](Handle id, Pipeline &pipe, GLPipeline &gpipe) {
         if (info.fileName == pipe.fileName)
         {
             gp = &gpipe;
@@ -331,6 +357,16 @@ GLPipeline ResourceSys::createPipeline(Pipeline info)
     {
         pipeline.programName = linkProgram(vertex, fragment);
     }
+    pipeline.instancedProgramName = linkVariant(info.fileName, "instanced");
+    pipeline.linesProgramName = linkVariant(info.fileName, "lines");
+    for (auto programName : {pipeline.programName, pipeline.instancedProgramName, pipeline.linesProgramName})
+    {
+        if (programName)
+            bindUniformBlocks(programName);
+    }
+    std::fill(std::begin(pipeline.uniforms), std::end(pipeline.uniforms), -1);
+    std::fill(std::begin(pipeline.instancedUniforms), std::end(pipeline.instancedUniforms), -1);
+    std::fill(std::begin(pipeline.linesUniforms), std::end(pipeline.linesUniforms), -1);
     std::ifstream fs(ResourceSys::absPath(info.fileName + ".json"));
     json js;
     fs >> js;
@@ -344,6 +380,10 @@ GLPipeline ResourceSys::createPipeline(Pipeline info)
             LOG_F(ERROR, "Shader param is not recognized ! %s", name.c_str());
         }
         pipeline.uniforms[type] = glGetUniformLocation(pipeline.programName, name.c_str());
+        if (pipeline.instancedProgramName)
+            pipeline.instancedUniforms[type] = glGetUniformLocation(pipeline.instancedProgramName, name.c_str());
+        if (pipeline.linesProgramName)
+            pipeline.linesUniforms[type] = glGetUniformLocation(pipeline.linesProgramName, name.c_str());
         i++;
     }
     r->createEntity(info, pipeline, Info{"Pipeline:"+info.fileName, 1});
@@ -427,68 +467,97 @@ void destroyRenderPass(RenderPassInstance &ins)
     //     }
 }
 
-GLGeometry createGeometry(Geometry info)
+// Points the attributes of the bound vertex array at vertices starting at offset in the bound array buffer.
+void setVertexAttributes(size_t offset)
 {
-    GLGeometry geo;
-    geo.indexbuffer = 0;
-    geo.vertexbuffer = 0;
-
-    glGenVertexArrays(1, &geo.vao);
-    glBindVertexArray(geo.vao);
-
-    glGenBuffers(1, &geo.vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, geo.vertexbuffer);
-    glBufferData(GL_ARRAY_BUFFER, info.vertices.size() * sizeof(Vertex), info.vertices.data(), GL_STATIC_DRAW);
-
     glVertexAttribPointer(0, 3,
-                          GL_FLOAT,                     // type
-                          GL_FALSE,                     // normalized?
-                          sizeof(Vertex),               // stride
-                          (void *)offsetof(Vertex, pos) // array buffer offset
+                          GL_FLOAT,                                // type
+                          GL_FALSE,                                // normalized?
+                          sizeof(Vertex),                          // stride
+                          (void *)(offset + offsetof(Vertex, pos)) // array buffer offset
     );
     glEnableVertexAttribArray(0);
 
     glVertexAttribPointer(1, 4,
-                          GL_FLOAT,                       // type
-                          GL_FALSE,                       // normalized?
-                          sizeof(Vertex),                 // stride
-                          (void *)offsetof(Vertex, color) // array buffer offset
+                          GL_FLOAT,                                  // type
+                          GL_FALSE,                                  // normalized?
+                          sizeof(Vertex),                            // stride
+                          (void *)(offset + offsetof(Vertex, color)) // array buffer offset
     );
     glEnableVertexAttribArray(1);
 
     glVertexAttribPointer(2, 2,
-                          GL_FLOAT,                    // type
-                          GL_FALSE,                    // normalized?
-                          sizeof(Vertex),              // stride
-                          (void *)offsetof(Vertex, uv) // array buffer offset
+                          GL_FLOAT,                               // type
+                          GL_FALSE,                               // normalized?
+                          sizeof(Vertex),                         // stride
+                          (void *)(offset + offsetof(Vertex, uv)) // array buffer offset
     );
     glEnableVertexAttribArray(2);
 
     glVertexAttribPointer(3, 3,
-                          GL_FLOAT,                        // type
-                          GL_FALSE,                        // normalized?
-                          sizeof(Vertex),                  // stride
-                          (void *)offsetof(Vertex, normal) // array buffer offset
+                          GL_FLOAT,                                   // type
+                          GL_FALSE,                                   // normalized?
+                          sizeof(Vertex),                             // stride
+                          (void *)(offset + offsetof(Vertex, normal)) // array buffer offset
     );
     glEnableVertexAttribArray(3);
+}
 
-    glGenBuffers(1, &geo.indexbuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geo.indexbuffer);
-
+// Dynamic geometries are written to the next region of their stream buffers on every update, the vertex array is
+// pointed at the new region instead of reallocating the buffers.
+void ResourceSys::streamGeometry(Handle entity, Geometry &info, GLGeometry &geo)
+{
+    auto &stream = streams[entity];
+    // A GLGeometry copied from another registry still names the vertex array of the original.
+    if (!stream.vao)
+        glGenVertexArrays(1, &stream.vao);
+    geo.vao = stream.vao;
+    glBindVertexArray(geo.vao);
+    auto offset =
+        stream.vertices.write(GL_ARRAY_BUFFER, info.vertices.data(), info.vertices.size() * sizeof(Vertex));
+    geo.vertexbuffer = stream.vertices.buffer;
+    setVertexAttributes(offset);
     if (info.indices.size())
     {
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, info.indices.size() * sizeof(unsigned int), &info.indices[0],
-                     GL_STATIC_DRAW);
+        geo.indexOffset = stream.indices.write(GL_ELEMENT_ARRAY_BUFFER, info.indices.data(),
+                                               info.indices.size() * sizeof(unsigned int));
+        geo.indexbuffer = stream.indices.buffer;
         geo.count = info.indices.size();
         geo.useIndex = true;
     }
     else
-    {        
+    {
         geo.count = info.vertices.size();
         geo.useIndex = false;
     }
-
     glBindVertexArray(0);
+}
+
+void ResourceSys::releaseStreams()
+{
+    for (auto it = streams.begin(); it != streams.end();)
+    {
+        if (r->has<GLGeometry>(it->first))
+        {
+            ++it;
+            continue;
+        }
+        it->second.vertices.destroy();
+        it->second.indices.destroy();
+        glDeleteVertexArrays(1, &it->second.vao);
+        it = streams.erase(it);
+    }
+}
+
+// Dynamic geometries get their vertex array and buffers from ResourceSys::streamGeometry.
+GLGeometry createGeometry(Geometry info)
+{
+    GLGeometry geo;
+    geo.indexbuffer = 0;
+    geo.vertexbuffer = 0;
+    geo.vao = 0;
+    geo.count = 0;
+    geo.useIndex = false;
 
     switch (info.type)
     {
@@ -499,6 +568,34 @@ GLGeometry createGeometry(Geometry info)
         geo.type = GL_TRIANGLES;
         break;
     }
+    if (info.bufferType == Geometry::BufferType::Dynamic)
+        return geo;
+    glGenVertexArrays(1, &geo.vao);
+    glBindVertexArray(geo.vao);
+
+    glGenBuffers(1, &geo.vertexbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, geo.vertexbuffer);
+    glBufferData(GL_ARRAY_BUFFER, info.vertices.size() * sizeof(Vertex), info.vertices.data(), GL_STATIC_DRAW);
+
+    setVertexAttributes(0);
+
+    glGenBuffers(1, &geo.indexbuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geo.indexbuffer);
+
+    if (info.indices.size())
+    {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, info.indices.size() * sizeof(unsigned int), &info.indices[0],
+                     GL_STATIC_DRAW);
+        geo.count = info.indices.size();
+        geo.useIndex = true;
+    }
+    else
+    {        
+        geo.count = info.vertices.size();
+        geo.useIndex = false;
+    }
+
+    glBindVertexArray(0);
     return geo;
 }
 
@@ -534,6 +631,12 @@ ResourceSys::ResourceSys()
 
 ResourceSys::~ResourceSys()
 {
+    for (auto &kv : streams)
+    {
+        kv.second.vertices.destroy();
+        kv.second.indices.destroy();
+        glDeleteVertexArrays(1, &kv.second.vao);
+    }
 }
 
 void ResourceSys::start()
@@ -545,25 +648,36 @@ void ResourceSys::process()
     //     syncResource<RenderTarget, GLRenderTarget>(
     //         [](Handle entity, auto info) { return createRenderTargetMultisampled(info); },
     //         [](RenderTarget &target) { return target.size.x > 0 && target.size.y > 0; });
-    syncResource<RenderPass, RenderPassInstance>([&](Handle entity, auto info) { return createRenderPass(info); },
-                                                 [](RenderPass &pass) { return pass.size.x > 0 && pass.size.y > 0; });
+    syncResource<RenderPass, RenderPassInstance>(
+        [&](Handle entity, auto info) { return createRenderPass(info); },
+        [](const RenderPass &pass) { return pass.size.x > 0 && pass.size.y > 0; });
+    releaseStreams();
     syncResource<Geometry, GLGeometry>(
-        [](Handle entity, auto &info) {
+        [&](Handle entity, auto &info) {
             info.updated = false;
-            return createGeometry(info);
+            auto geo = createGeometry(info);
+            if (info.bufferType == Geometry::BufferType::Dynamic)
+                streamGeometry(entity, info, geo);
+            return geo;
         },
-        nullptr, [&](Geometry &geo, GLGeometry& ggeo) {  
-            if (geo.updated)
-                updateGeometry(geo, ggeo);
+        nullptr, [&](Handle entity, const Geometry &geo, GLGeometry& ggeo) {  
+            if (!geo.updated)
+                return;
+            auto &info = r->get<Geometry>(entity);
+            if (info.bufferType == Geometry::BufferType::Dynamic)
+                streamGeometry(entity, info, ggeo);
+            else
+                updateGeometry(info, ggeo);
+            info.updated = false;
         });
 
     syncResource<Texture, GLTexture>([](Handle entity, auto info) { return createTexture(info); });
 
-    r->each<RenderPass, RenderPassInstance>(
-        [&](int entity, RenderPass &pass, RenderPassInstance &ins) {
+    r->readEach<RenderPass, RenderPassInstance>(
+        [&](Handle entity, const RenderPass &pass, const RenderPassInstance &ins) {
             if (pass.size != ins.renderPass.size)
             {
-                resizeRenderPass(pass, ins);
+                resizeRenderPass(pass, r->get<RenderPassInstance>(entity));
             }
         });
 }
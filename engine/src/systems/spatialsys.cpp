@@ -0,0 +1,88 @@
+#include "systems/spatialsys.h"
+
+#include "components/transform.h"
+
+SpatialSys *SpatialSys::_instance = nullptr;
+
+SpatialSys::SpatialSys()
+{
+    reads<Transform, BBox>();
+    mainThread = false;
+}
+
+void SpatialSys::start()
+{
+}
+
+void SpatialSys::process()
+{
+    frame++;
+    size_t seen = 0;
+    // Only declared as a reader, so the components are walked read only.
+    r->readEach<Transform, BBox>([&](Handle entity, const Transform &transform, const BBox &box) {
+        if (box.empty)
+            return;
+        seen++;
+        auto it = proxies.find(entity);
+        if (it == proxies.end())
+        {
+            auto leaf = tree.insert(transform.worldMatrix() * box, entity);
+            proxies[entity] = Proxy{leaf, transform.revision, box, frame};
+            return;
+        }
+        auto &proxy = it->second;
+        proxy.frame = frame;
+        if (proxy.revision != transform.revision || proxy.box.min != box.min || proxy.box.max != box.max)
+        {
+            proxy.revision = transform.revision;
+            proxy.box = box;
+            tree.update(proxy.leaf, transform.worldMatrix() * box);
+        }
+    });
+    if (seen == proxies.size())
+        return;
+    for (auto it = proxies.begin(); it != proxies.end();)
+    {
+        if (it->second.frame != frame)
+        {
+            tree.remove(it->second.leaf);
+            it = proxies.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+Handle SpatialSys::raycast(const Ray &ray, float *distance, const std::function<bool(Handle)> &filter)
+{
+    float d;
+    auto hit = tree.raycast(ray, d, filter);
+    if (distance)
+        *distance = d;
+    return hit;
+}
+
+std::vector<Handle> SpatialSys::overlap(const BBox &box)
+{
+    std::vector<Handle> ret;
+    tree.overlap(box, ret);
+    return ret;
+}
+
+std::vector<Handle> SpatialSys::frustumQuery(const mat4 &viewProjection)
+{
+    std::vector<Handle> ret;
+    tree.query(Frustum(viewProjection), ret);
+    return ret;
+}
+
+SpatialSys *SpatialSys::instance()
+{
+    if (!_instance)
+    {
+        _instance = new SpatialSys();
+    }
+    return _instance;
+}
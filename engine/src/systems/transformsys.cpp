@@ -4,17 +4,135 @@
 #include "components/transform.h"
 #include "engine.h"
 
+#include <algorithm>
+#include <unordered_map>
+
+TransformSys::TransformSys()
+{
+    reads<Relation>();
+    writes<Transform>();
+    mainThread = false;
+}
 
 void TransformSys::start()
 {
 }
 
+mat4 TransformSys::currentWorld(Registry *r, Handle entity)
+{
+    mat4 world = glm::identity<mat4>();
+    // Bounded like depthOf() in rebuild(), in case the hierarchy has a cycle.
+    auto limit = r->view<Transform>().size();
+    for (size_t depth = 0; entity && depth < limit; depth++)
+    {
+        auto transform = r->read<Transform>(entity);
+        if (!transform)
+            break;
+        world = transform->matrix() * world;
+        auto rel = r->read<Relation>(entity);
+        entity = rel ? rel->parent : 0;
+    }
+    return world;
+}
+
+bool TransformSys::hierarchyChanged()
+{
+    if (r->view<Transform>().size() != nodes.size())
+        return true;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        transforms[i] = r->getPtr<Transform>(nodes[i].entity);
+        auto rel = r->getPtr<Relation>(nodes[i].entity);
+        if (!transforms[i] || (rel ? rel->parent : 0) != nodes[i].parentEntity)
+            return true;
+    }
+    return false;
+}
+
+void TransformSys::rebuild()
+{
+    auto entities = r->findAll<Transform>();
+    std::unordered_map<Handle, int> depths;
+    std::function<int(Handle, size_t)> depthOf = [&](Handle entity, size_t limit) {
+        auto it = depths.find(entity);
+        if (it != depths.end())
+            return it->second;
+        auto rel = r->getPtr<Relation>(entity);
+        int depth = 0;
+        // The limit stops cycles in broken hierarchies.
+        if (rel && rel->parent && limit && r->has<Transform>(rel->parent))
+            depth = depthOf(rel->parent, limit - 1) + 1;
+        depths[entity] = depth;
+        return depth;
+    };
+    for (auto entity : entities)
+    {
+        depthOf(entity, entities.size());
+    }
+    std::stable_sort(entities.begin(), entities.end(), [&](Handle a, Handle b) { return depths[a] < depths[b]; });
+
+    std::unordered_map<Handle, int> indices;
+    nodes.clear();
+    for (auto entity : entities)
+    {
+        auto rel = r->getPtr<Relation>(entity);
+        Node node{entity, rel ? rel->parent : 0, -1};
+        auto parent = indices.find(node.parentEntity);
+        if (node.parentEntity && parent != indices.end())
+            node.parent = parent->second;
+        indices[entity] = int(nodes.size());
+        nodes.push_back(node);
+    }
+    transforms.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        transforms[i] = r->getPtr<Transform>(nodes[i].entity);
+    }
+    locals.resize(nodes.size());
+}
+
 void TransformSys::process()
 {
-    r->each<Relation, Transform>([&](Handle entity, Relation& rel, Transform &transform) {
-        if (rel.parent)
+    bool all = hierarchyChanged();
+    if (all)
+        rebuild();
+
+    // Local matrices of everything that moved are composed in one batch.
+    batch.clear();
+    changed.clear();
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        auto &node = nodes[i];
+        auto &transform = *transforms[i];
+        if (all || transform.position != node.position || transform.rotation != node.rotation ||
+            transform.scaling != node.scaling)
+        {
+            node.position = transform.position;
+            node.rotation = transform.rotation;
+            node.scaling = transform.scaling;
+            batch.push(node.position, node.rotation, node.scaling);
+            changed.push_back(int(i));
+        }
+    }
+    composed.resize(batch.size());
+    batch.compose(composed.data());
+    dirty.assign(nodes.size(), false);
+    for (size_t c = 0; c < changed.size(); c++)
+    {
+        locals[changed[c]] = composed[c];
+        dirty[changed[c]] = true;
+    }
+
+    // One pass in depth order, a world matrix is only rebuilt when its local values or its parent changed.
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        auto parent = nodes[i].parent;
+        if (parent > -1 && dirty[parent])
+            dirty[i] = true;
+        if (dirty[i])
         {
-            transform.parentWorldTransform = r->get<Transform>(rel.parent).worldMatrix();
+            transforms[i]->world = parent > -1 ? transforms[parent]->world * locals[i] : locals[i];
+            transforms[i]->revision++;
         }
-    });
+    }
 }
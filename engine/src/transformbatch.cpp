@@ -0,0 +1,92 @@
+#include "transformbatch.h"
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86_FP)
+#include <xmmintrin.h>
+#define TRANSFORM_BATCH_SSE
+#endif
+
+void TransformBatch::clear()
+{
+    for (auto array : {&px, &py, &pz, &qx, &qy, &qz, &qw, &sx, &sy, &sz})
+    {
+        array->clear();
+    }
+}
+
+void TransformBatch::push(const vec3 &position, const quat &rotation, const vec3 &scaling)
+{
+    px.push_back(position.x);
+    py.push_back(position.y);
+    pz.push_back(position.z);
+    qx.push_back(rotation.x);
+    qy.push_back(rotation.y);
+    qz.push_back(rotation.z);
+    qw.push_back(rotation.w);
+    sx.push_back(scaling.x);
+    sy.push_back(scaling.y);
+    sz.push_back(scaling.z);
+}
+
+static void composeOne(const TransformBatch &b, size_t i, mat4 &m)
+{
+    float x = b.qx[i], y = b.qy[i], z = b.qz[i], w = b.qw[i];
+    m[0] = vec4((1 - 2 * (y * y + z * z)) * b.sx[i], 2 * (x * y + w * z) * b.sx[i], 2 * (x * z - w * y) * b.sx[i], 0);
+    m[1] = vec4(2 * (x * y - w * z) * b.sy[i], (1 - 2 * (x * x + z * z)) * b.sy[i], 2 * (y * z + w * x) * b.sy[i], 0);
+    m[2] = vec4(2 * (x * z + w * y) * b.sz[i], 2 * (y * z - w * x) * b.sz[i], (1 - 2 * (x * x + y * y)) * b.sz[i], 0);
+    m[3] = vec4(b.px[i], b.py[i], b.pz[i], 1);
+}
+
+void TransformBatch::compose(mat4 *out) const
+{
+    size_t i = 0;
+#ifdef TRANSFORM_BATCH_SSE
+    // Four entries per iteration, each register holds one matrix element of four entries. The 4x4 transposes turn
+    // those back into one column per entry.
+    const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+    for (; i + 4 <= size(); i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&qx[i]), y = _mm_loadu_ps(&qy[i]), z = _mm_loadu_ps(&qz[i]), w = _mm_loadu_ps(&qw[i]);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+        __m128 scaleX = _mm_loadu_ps(&sx[i]), scaleY = _mm_loadu_ps(&sy[i]), scaleZ = _mm_loadu_ps(&sz[i]);
+
+        __m128 c0[4] = {
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX),
+            zero,
+        };
+        __m128 c1[4] = {
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY),
+            zero,
+        };
+        __m128 c2[4] = {
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ),
+            zero,
+        };
+        __m128 c3[4] = {_mm_loadu_ps(&px[i]), _mm_loadu_ps(&py[i]), _mm_loadu_ps(&pz[i]), one};
+
+        for (auto column : {c0, c1, c2, c3})
+        {
+            _MM_TRANSPOSE4_PS(column[0], column[1], column[2], column[3]);
+        }
+        for (int e = 0; e < 4; e++)
+        {
+            float *m = &out[i + e][0][0];
+            _mm_storeu_ps(m, c0[e]);
+            _mm_storeu_ps(m + 4, c1[e]);
+            _mm_storeu_ps(m + 8, c2[e]);
+            _mm_storeu_ps(m + 12, c3[e]);
+        }
+    }
+#endif
+    for (; i < size(); i++)
+    {
+        composeOne(*this, i, out[i]);
+    }
+}
@@ -145,13 +145,17 @@ std::vector<vec3> BBox::vertices() const
 
 BBox operator*(const mat4 &mat, const BBox &box)
 {
-    BBox ret;
-    auto verts = box.vertices();
-    for (int i = 0; i < 8; i++)
+    if (box.empty)
+        return box;
+    // Transform the center and project the extents on each axis instead of transforming all eight corners.
+    auto center = vec3(mat * vec4((box.min + box.max) * 0.5f, 1.0f));
+    auto extents = (box.max - box.min) * 0.5f;
+    vec3 radius;
+    for (int i = 0; i < 3; i++)
     {
-        ret.addPoint(mat * vec4(verts[i], 1.0f));
+        radius[i] = glm::abs(mat[0][i]) * extents.x + glm::abs(mat[1][i]) * extents.y + glm::abs(mat[2][i]) * extents.z;
     }
-    return ret;
+    return BBox(center - radius, center + radius);
 }
 
 BBox operator+(const BBox &a, const BBox &b)
@@ -174,3 +178,32 @@ BBox operator+=(BBox &a, const BBox &b)
     a.max = glm::max(a.max, b.max);
     return a + b;
 }
+
+Frustum::Frustum(const mat4 &m)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        for (int side = 0; side < 2; side++)
+        {
+            auto &plane = planes[i * 2 + side];
+            for (int c = 0; c < 4; c++)
+            {
+                plane[c] = m[c][3] + (side ? -m[c][i] : m[c][i]);
+            }
+            plane /= glm::length(vec3(plane));
+        }
+    }
+}
+
+bool Frustum::intersects(const BBox &box) const
+{
+    for (auto &plane : planes)
+    {
+        // Corner furthest along the plane normal.
+        vec3 p(plane.x > 0 ? box.max.x : box.min.x, plane.y > 0 ? box.max.y : box.min.y,
+               plane.z > 0 ? box.max.z : box.min.z);
+        if (glm::dot(vec3(plane), p) + plane.w < 0)
+            return false;
+    }
+    return true;
+}
@@ -20,6 +20,12 @@ Handle viewport = 0;
 class GameSys : public System
 {
   public:
+    GameSys()
+    {
+        writes<Transform>();
+        mainThread = false;
+    }
+
     void start() override
     {
         LOG_F(INFO, "game system started!");
@@ -72,7 +78,7 @@ class GameSys : public System
         {
             LOG_F(INFO, "game system running! 11");
         }
-        r->each<Transform>([time](Handle entity, Transform &t) { 
+        r->par_each<Transform>([time](Handle entity, Transform &t) {
             t.position += ((time % 1000 - 500) / 5000.0f);
         });
     }